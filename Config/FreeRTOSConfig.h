@@ -63,6 +63,7 @@
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
 #define configUSE_IDLE_HOOK                      0
 #define configUSE_TICK_HOOK                      0
+#define configUSE_TICKLESS_IDLE                  1
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
@@ -71,6 +72,7 @@
 #define configMAX_TASK_NAME_LEN                  ( 16 )
 #define configUSE_TRACE_FACILITY                 1
 #define configUSE_16_BIT_TICKS                   0
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES    2
 #define configUSE_MUTEXES                        1
 #define configQUEUE_REGISTRY_SIZE                8
 #define configUSE_RECURSIVE_MUTEXES              1
@@ -148,6 +150,75 @@ header file. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+
+/* Tickless idle stops SysTick and the HAL's TIM6 timebase while no task is
+ready to run: `vPortSuppressTicksAndSleep()` in `power.c` replaces the port's. */
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP    2
+
+/* Run-time stats time each task in microseconds, from the HAL's 1MHz TIM6
+timebase, which is already running, or the monotonic clock on the host.
+Reading it costs a few register reads per context switch: see `cpu.c`. */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+extern uint32_t timestamp_us(void);
+#endif
+#define configGENERATE_RUN_TIME_STATS            1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()         timestamp_us()
+
+/* TRACE_RECORDER, set in `CMakeLists.txt`, records kernel events in a RAM ring
+buffer: see `trace.c`. The event types are shared with `trace.c` through
+`trace_events.h`. The macros use only the arguments the kernel passes them.
+Each new task is numbered in creation order by `trace_task_created()`, through
+`vTaskSetTaskNumber()`, so a trace dump can name the tasks. A notification
+records its sender; the task it readies records a TASK_READY event. */
+#if defined(TRACE_RECORDER) && TRACE_RECORDER == 1
+#include "trace_events.h"
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+extern void trace_record(uint8_t type, uint8_t task, uint16_t arg);
+extern void trace_record_task(uint8_t type, void* task, uint16_t arg);
+extern void trace_task_created(void* task);
+#endif
+#define traceTASK_CREATE(pxNewTCB)               trace_task_created(pxNewTCB)
+#define traceTASK_SWITCHED_IN()                  trace_record_task(TRACE_EVENT_TASK_IN, NULL, 0)
+#define traceTASK_SWITCHED_OUT()                 trace_record_task(TRACE_EVENT_TASK_OUT, NULL, 0)
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB)    trace_record_task(TRACE_EVENT_TASK_READY, (pxTCB), 0)
+#define traceTASK_NOTIFY(uxIndexToNotify)        trace_record_task(TRACE_EVENT_NOTIFY, NULL, (uint16_t)(uxIndexToNotify))
+#define traceTASK_NOTIFY_FROM_ISR(uxIndexToNotify) trace_record(TRACE_EVENT_NOTIFY_FROM_ISR, 0, (uint16_t)(uxIndexToNotify))
+#define traceTASK_NOTIFY_GIVE_FROM_ISR(uxIndexToNotify) trace_record(TRACE_EVENT_NOTIFY_FROM_ISR, 0, (uint16_t)(uxIndexToNotify))
+#define traceTASK_NOTIFY_TAKE(uxIndexToWait)     trace_record_task(TRACE_EVENT_NOTIFY_RECEIVED, NULL, (uint16_t)(uxIndexToWait))
+#define traceTASK_NOTIFY_WAIT(uxIndexToWait)     trace_record_task(TRACE_EVENT_NOTIFY_RECEIVED, NULL, (uint16_t)(uxIndexToWait))
+#define traceTIMER_COMMAND_SEND(xTimer, xMessageID, xMessageValueValue, xReturn) trace_record_task(TRACE_EVENT_TIMER_COMMAND, NULL, (uint16_t)(xMessageID))
+#define traceTIMER_EXPIRED(pxTimer)              trace_record_task(TRACE_EVENT_TIMER_EXPIRED, NULL, 0)
+#endif
+
+/* STATIC_ALLOCATION, set in `CMakeLists.txt`, creates every task, queue and
+timer in build-time storage. The FreeRTOS heap is then left out of the build. */
+#if defined(STATIC_ALLOCATION) && STATIC_ALLOCATION == 1
+#undef configSUPPORT_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION          1
+#undef configSUPPORT_DYNAMIC_ALLOCATION
+#define configSUPPORT_DYNAMIC_ALLOCATION         0
+#endif
+
+#ifdef HOST_BUILD
+/* The host build runs on the FreeRTOS POSIX port. Stack words are 64 bits
+wide there, so the heap needs to be larger for the same task stack depths. */
+#undef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE                    ((size_t)(512 * 1024))
+
+/* The tick hook drives the simulated MCP9808 ALERT line. */
+#undef configUSE_TICK_HOOK
+#define configUSE_TICK_HOOK                      1
+
+/* The POSIX port has no tickless idle mode. */
+#undef configUSE_TICKLESS_IDLE
+#define configUSE_TICKLESS_IDLE                  0
+
+/* Report failed asserts rather than spin with the signals masked. */
+#undef configASSERT
+extern void host_assert_failed(const char* file, int line);
+#define configASSERT( x ) if ((x) == 0) { host_assert_failed(__FILE__, __LINE__); }
+#endif
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,32 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef TRACE_EVENTS_HEADER
+#define TRACE_EVENTS_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+// Trace event types, shared by the kernel's trace macros in
+// `FreeRTOSConfig.h` and the recorder in `trace.c`. `task` is
+// a task number, or 0 for an interrupt
+#define     TRACE_EVENT_TASK_IN                 1
+#define     TRACE_EVENT_TASK_OUT                2
+#define     TRACE_EVENT_NOTIFY                  3   // task: the sender, arg: the index
+#define     TRACE_EVENT_NOTIFY_FROM_ISR         4   // arg: the index
+#define     TRACE_EVENT_NOTIFY_RECEIVED         5   // The task's wait ended. arg: the index
+#define     TRACE_EVENT_TIMER_COMMAND           6   // arg: the command ID
+#define     TRACE_EVENT_TIMER_EXPIRED           7
+#define     TRACE_EVENT_ISR_ENTER               8   // arg: the IRQ number
+#define     TRACE_EVENT_ISR_EXIT                9   // arg: the IRQ number
+#define     TRACE_EVENT_TRIGGER                 10
+#define     TRACE_EVENT_TASK_READY              11  // task: the task made ready, eg. by a notification
+
+
+#endif  // TRACE_EVENTS_HEADER
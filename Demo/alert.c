@@ -0,0 +1,259 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static void task_alert(void* argument);
+static void alert_timer_fired(TimerHandle_t timer);
+static void alert_set_state(uint8_t state);
+static void alert_start_timer(uint32_t period_ms);
+
+
+/*
+ * GLOBALS
+ */
+// The alert task, the task which reads the sensors for it,
+// and the timer which schedules those reads
+static TaskHandle_t     handle_task_alert = NULL;
+static TaskHandle_t     handle_check_task = NULL;
+static TimerHandle_t    alert_timer = NULL;
+
+// The state is only changed by the alert task. The LED is lit from
+// the moment the interrupt fires, before the task has run
+static volatile uint8_t alert_state = ALERT_STATE_IDLE;
+static volatile bool    alert_lit = false;
+
+static const char* state_names[] = { "idle", "active", "cooling", "cleared" };
+
+// Latency measurement: the cycle count when the interrupt fired, when
+// the first re-check after it is due, in microseconds, and the cycle
+// count when its timer callback ran -- see `latency.c`
+static volatile uint32_t    alert_raised_cycles = 0;
+static volatile bool        alert_raised_pending = false;
+static volatile uint32_t    alert_recheck_due_us = 0;
+static volatile uint32_t    alert_recheck_fired_cycles = 0;
+static volatile uint8_t     alert_recheck_stage = LATENCY_STAGE_COUNT;
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+static StackType_t      task_alert_stack[ALERT_TASK_STACK_SIZE];
+static StaticTask_t     task_alert_tcb;
+static StaticTimer_t    alert_timer_storage;
+#endif
+
+
+/**
+ * @brief Create the alert task, and the one timer it uses for every alert.
+ *
+ * @param check_task: The task which reads the sensors when the alert needs
+ *                    a check. It's notified with `ALERT_NOTIFY_CHECK`, and
+ *                    should pass the readings to `alert_check()`.
+ *
+ * @returns `pdPASS` if the task and timer were created, otherwise an error code.
+ */
+BaseType_t alert_create_task(TaskHandle_t check_task) {
+
+    handle_check_task = check_task;
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    alert_timer = xTimerCreateStatic("ALERT_TIMER", pdMS_TO_TICKS(ALERT_DISPLAY_PERIOD_MS), pdFALSE, NULL,
+                                     alert_timer_fired, &alert_timer_storage);
+    handle_task_alert = xTaskCreateStatic(task_alert, "ALERT_TASK", ALERT_TASK_STACK_SIZE, NULL, ALERT_TASK_PRIORITY,
+                                          task_alert_stack, &task_alert_tcb);
+    if (handle_task_alert == NULL) return pdFAIL;
+#else
+    alert_timer = xTimerCreate("ALERT_TIMER", pdMS_TO_TICKS(ALERT_DISPLAY_PERIOD_MS), pdFALSE, NULL,
+                               alert_timer_fired);
+    BaseType_t status = xTaskCreate(task_alert, "ALERT_TASK", ALERT_TASK_STACK_SIZE, NULL, ALERT_TASK_PRIORITY,
+                                    &handle_task_alert);
+    if (status != pdPASS) return status;
+#endif
+
+    return (alert_timer != NULL) ? pdPASS : errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+}
+
+
+/**
+ * @brief Signal that the ALERT line has asserted. Call from the interrupt handler.
+ *
+ * @param higher_priority_task_woken: Set to `pdTRUE` if the alert task should
+ *                                    run when the handler returns.
+ */
+void alert_raise_from_isr(BaseType_t* higher_priority_task_woken) {
+
+    // Time the first interrupt until the alert task handles it
+    if (!alert_raised_pending) {
+        alert_raised_cycles = timestamp_cycles();
+        alert_raised_pending = true;
+    }
+
+    // Make sure the LED flasher task doesn't flash the LED
+    alert_lit = true;
+    if (handle_task_alert != NULL) {
+        xTaskNotifyFromISR(handle_task_alert, ALERT_EVENT_RAISED, eSetBits, higher_priority_task_woken);
+    }
+}
+
+
+/**
+ * @brief Pass the alert the readings of a check. A sensor which can't be read
+ *        counts as too hot. Called by the check task after it's notified.
+ *
+ * @param temps:   The sensors' temperatures, in 1/16°C.
+ * @param results: The outcome of each read.
+ * @param swept:   A bitmask of the sensors read, from `MCP9808_sweep()`.
+ */
+void alert_check(const int16_t* temps, const HAL_StatusTypeDef* results, uint8_t swept) {
+
+    // The sensors share the ALERT pin, so every one must have cooled
+    // NOTE The MCP9808 does not signal this on the ALERT pin
+    bool is_cool = true;
+    for (uint8_t i = 0 ; i < MCP9808_MAX_DEVICES ; ++i) {
+        if ((swept & (1 << i)) == 0) continue;
+        if (results[i] != HAL_OK || temps[i] >= TEMP_UPPER_LIMIT_C * MCP9808_TEMP_SCALE - ALERT_HYSTERESIS) is_cool = false;
+    }
+
+    // Time the first re-check after an interrupt from its timer callback
+    if (alert_recheck_stage == LATENCY_STAGE_CHECK) {
+        latency_record(LATENCY_STAGE_CHECK, (timestamp_cycles() - alert_recheck_fired_cycles) / timestamp_cycles_per_us());
+        alert_recheck_stage = LATENCY_STAGE_COUNT;
+    }
+
+    if (handle_task_alert != NULL) xTaskNotify(handle_task_alert, is_cool ? ALERT_EVENT_COOL : ALERT_EVENT_HOT, eSetBits);
+}
+
+
+/**
+ * @brief Get the alert's state.
+ *
+ * @returns The state, eg. `ALERT_STATE_ACTIVE`.
+ */
+uint8_t alert_get_state(void) {
+
+    return alert_state;
+}
+
+
+/**
+ * @brief Check whether the alert has the LED lit, so it shouldn't flash.
+ *
+ * @returns `true` from the ALERT interrupt until the alert clears.
+ */
+bool alert_is_lit(void) {
+
+    return alert_lit;
+}
+
+
+/**
+ * @brief  Function implementing the alert task: runs the state machine.
+ *         Check results are applied before a new interrupt, so a check
+ *         which was under way when the interrupt fired can't clear it.
+ *
+ * @param  argument: Not used
+ */
+static void task_alert(void* argument) {
+
+    while (1) {
+        // Block until an event arrives
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+
+        // Take the interrupt's time, so the next interrupt can record its own
+        const uint32_t raised_cycles = alert_raised_cycles;
+        if (events & ALERT_EVENT_RAISED) alert_raised_pending = false;
+
+        const uint8_t state = alert_state;
+        if ((events & ALERT_EVENT_HOT) && (state == ALERT_STATE_ACTIVE || state == ALERT_STATE_COOLING)) {
+            // Temperature still too high -- check again later
+            alert_set_state(ALERT_STATE_ACTIVE);
+            alert_start_timer(ALERT_DISPLAY_PERIOD_MS);
+        } else if ((events & ALERT_EVENT_COOL) && state == ALERT_STATE_ACTIVE) {
+            // Below the limit, by the hysteresis: confirm it with one more check
+            alert_set_state(ALERT_STATE_COOLING);
+            alert_start_timer(ALERT_COOLING_PERIOD_MS);
+        } else if ((events & ALERT_EVENT_COOL) && state == ALERT_STATE_COOLING) {
+            alert_set_state(ALERT_STATE_CLEARED);
+        }
+
+        // Capture the kernel trace around the interrupt -- see `trace.c`
+        if (events & ALERT_EVENT_RAISED) trace_trigger();
+
+        if ((events & ALERT_EVENT_RAISED) && alert_state != ALERT_STATE_ACTIVE) {
+            // Timed as the LED is lit, before the state change is logged
+            latency_record(LATENCY_STAGE_LED, (timestamp_cycles() - raised_cycles) / timestamp_cycles_per_us());
+            alert_set_state(ALERT_STATE_ACTIVE);
+            alert_recheck_stage = LATENCY_STAGE_TIMER;
+            alert_start_timer(ALERT_DISPLAY_PERIOD_MS);
+        }
+    }
+}
+
+
+/**
+ * @brief Move the alert to a new state, and light or clear the LED to match.
+ *
+ * @param state: The new state, eg. `ALERT_STATE_COOLING`.
+ */
+static void alert_set_state(uint8_t state) {
+
+    if (state == alert_state) return;
+
+    // The LED stays lit until the alert clears
+    const bool is_lit = (state == ALERT_STATE_ACTIVE || state == ALERT_STATE_COOLING);
+    HAL_GPIO_WritePin(LED_GPIO_PORT, LED_GPIO_PIN, is_lit ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    alert_lit = is_lit;
+
+    alert_state = state;
+    server_log("Alert %s", state_names[state]);
+
+    // Report the alert path's latencies as each alert ends
+    if (state == ALERT_STATE_CLEARED) latency_log_stats();
+}
+
+
+/**
+ * @brief Restart the alert timer, to request a check after a period.
+ *
+ * @param period_ms: The period in milliseconds.
+ */
+static void alert_start_timer(uint32_t period_ms) {
+
+    // Changing the period restarts the timer too
+    const TickType_t period = pdMS_TO_TICKS(period_ms);
+    alert_recheck_due_us = timestamp_us() + period_ms * 1000;
+    if (xTimerGetPeriod(alert_timer) != period) {
+        xTimerChangePeriod(alert_timer, period, SENSOR_TASK_WAIT_TICKS);
+    } else {
+        xTimerReset(alert_timer, SENSOR_TASK_WAIT_TICKS);
+    }
+}
+
+
+/**
+ * @brief Callback actioned when the alert timer fires. It runs in the timer
+ *        service task, so it only asks the check task to read the sensors.
+ *
+ * @param timer: The triggering timer.
+ */
+static void alert_timer_fired(TimerHandle_t timer) {
+
+    // Time the first re-check after an interrupt from when it was due. The
+    // timer's period can outlast the cycle counter, so this is in microseconds
+    if (alert_recheck_stage == LATENCY_STAGE_TIMER) {
+        alert_recheck_fired_cycles = timestamp_cycles();
+        const int32_t late_us = (int32_t)(timestamp_us() - alert_recheck_due_us);
+        latency_record(LATENCY_STAGE_TIMER, (late_us > 0) ? (uint32_t)late_us : 0);
+        alert_recheck_stage = LATENCY_STAGE_CHECK;
+    }
+
+    if (handle_check_task != NULL) xTaskNotify(handle_check_task, ALERT_NOTIFY_CHECK, eSetBits);
+}
@@ -0,0 +1,60 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef ALERT_HEADER
+#define ALERT_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+// Alert states. An ALERT interrupt makes the alert active. Once every
+// sensor reads ALERT_HYSTERESIS (in 1/16°C) below the upper limit, it
+// is cooling, and if they all still do ALERT_COOLING_PERIOD_MS later,
+// it's cleared. A hot reading, or another interrupt, makes it active again
+#define     ALERT_STATE_IDLE                    0
+#define     ALERT_STATE_ACTIVE                  1
+#define     ALERT_STATE_COOLING                 2
+#define     ALERT_STATE_CLEARED                 3
+
+#define     ALERT_HYSTERESIS                    16
+#define     ALERT_COOLING_PERIOD_MS             10000
+
+// Events sent to the alert task as notification bits
+#define     ALERT_EVENT_RAISED                  0x01
+#define     ALERT_EVENT_HOT                     0x02
+#define     ALERT_EVENT_COOL                    0x04
+
+// Sent to the check task when the sensors should be read for the alert
+#define     ALERT_NOTIFY_CHECK                  0x01
+
+#define     ALERT_TASK_STACK_SIZE               1024
+#define     ALERT_TASK_PRIORITY                 tskIDLE_PRIORITY
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+BaseType_t  alert_create_task(TaskHandle_t check_task);
+void        alert_raise_from_isr(BaseType_t* higher_priority_task_woken);
+void        alert_check(const int16_t* temps, const HAL_StatusTypeDef* results, uint8_t swept);
+uint8_t     alert_get_state(void);
+bool        alert_is_lit(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // ALERT_HEADER
@@ -0,0 +1,80 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * GLOBALS
+ */
+// When each phase completed, in microseconds from `timestamp_us()`.
+// Each phase is marked by one task, so no lock is needed
+static volatile uint32_t    boot_times_us[BOOT_PHASE_COUNT] = { 0 };
+static volatile bool        boot_marked[BOOT_PHASE_COUNT] = { false };
+static bool                 boot_reported = false;
+
+
+/**
+ * @brief Record the time a startup phase completed. Only the first mark
+ *        of each phase counts, so a call site on a path which repeats,
+ *        eg. posting logs, marks the first time only.
+ *
+ *        NOTE `HAL_Init()` starts the timebase that `timestamp_us()`
+ *             reads, so times run from there, not from reset.
+ *
+ * @param phase: The phase, eg. `BOOT_PHASE_I2C`.
+ */
+void boot_mark(uint8_t phase) {
+
+    if (phase >= BOOT_PHASE_COUNT || boot_marked[phase]) return;
+    boot_times_us[phase] = timestamp_us();
+    boot_marked[phase] = true;
+}
+
+
+/**
+ * @brief Get the time a startup phase completed.
+ *
+ * @param phase: The phase, eg. `BOOT_PHASE_FIRST_SAMPLE`.
+ *
+ * @returns The time in microseconds, or 0 if the phase has yet to complete.
+ */
+uint32_t boot_get_time_us(uint8_t phase) {
+
+    if (phase >= BOOT_PHASE_COUNT || !boot_marked[phase]) return 0;
+    return boot_times_us[phase];
+}
+
+
+/**
+ * @brief Log the startup timeline, once: when each phase completed, in
+ *        microseconds. Does nothing until the first sample has been taken
+ *        and the first log posted, unless `BOOT_REPORT_TIMEOUT_MS` has
+ *        passed, eg. because there's no sensor. Phases yet to complete
+ *        then show as 0. Call it periodically from a task.
+ */
+void boot_report(void) {
+
+    if (boot_reported) return;
+    if (!(boot_marked[BOOT_PHASE_FIRST_SAMPLE] && boot_marked[BOOT_PHASE_FIRST_LOG]) &&
+        xTaskGetTickCount() < pdMS_TO_TICKS(BOOT_REPORT_TIMEOUT_MS)) return;
+
+    boot_reported = true;
+    server_log("Boot (us): HAL %lu, clock %lu, GPIO %lu, tasks %lu, info %lu, first log %lu",
+               (unsigned long)boot_get_time_us(BOOT_PHASE_HAL),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_CLOCK),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_GPIO),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_TASKS),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_DEVICE_INFO),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_FIRST_LOG));
+    server_log("Boot (us): I2C %lu, sensor found %lu, configured %lu, first sample %lu",
+               (unsigned long)boot_get_time_us(BOOT_PHASE_I2C),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_SENSOR_FOUND),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_SENSOR_CONFIGURED),
+               (unsigned long)boot_get_time_us(BOOT_PHASE_FIRST_SAMPLE));
+}
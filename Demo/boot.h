@@ -0,0 +1,53 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef BOOT_HEADER
+#define BOOT_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+// Startup phases, in the order they usually complete. Those up to
+// BOOT_PHASE_TASKS run in `main()`, the rest in the tasks
+#define     BOOT_PHASE_HAL                      0
+#define     BOOT_PHASE_CLOCK                    1
+#define     BOOT_PHASE_GPIO                     2
+#define     BOOT_PHASE_TASKS                    3
+#define     BOOT_PHASE_DEVICE_INFO              4
+#define     BOOT_PHASE_I2C                      5
+#define     BOOT_PHASE_SENSOR_FOUND             6
+#define     BOOT_PHASE_SENSOR_CONFIGURED        7
+#define     BOOT_PHASE_FIRST_SAMPLE             8
+#define     BOOT_PHASE_FIRST_LOG                9
+#define     BOOT_PHASE_COUNT                    10
+
+// The boot report is logged once the first sample and the first log
+// post are timed, or after this period if they haven't happened
+#define     BOOT_REPORT_TIMEOUT_MS              30000
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void        boot_mark(uint8_t phase);
+uint32_t    boot_get_time_us(uint8_t phase);
+void        boot_report(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // BOOT_HEADER
@@ -0,0 +1,92 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static uint32_t cpu_tenths(uint32_t part_us, uint32_t whole_us);
+
+
+/*
+ * GLOBALS
+ */
+static TaskStatus_t cpu_tasks[CPU_MAX_TASKS];
+static CpuTaskTime  cpu_reported[CPU_MAX_TASKS] = { 0 };
+static UBaseType_t  cpu_reported_count = 0;
+static uint32_t     cpu_reported_us = 0;
+
+
+/**
+ * @brief Log each task's share of the CPU since the last call, or since
+ *        boot: idle first, then every other task.
+ *
+ *        FreeRTOS adds up each task's run time at every context switch,
+ *        reading `timestamp_us()`, ie. TIM6 on the board and the monotonic
+ *        clock on the host. Time the core spends asleep in tickless idle
+ *        counts as idle. The counters are 32-bit microseconds, so the
+ *        interval between calls must be less than 71 minutes.
+ */
+void cpu_log_stats(void) {
+
+    uint32_t total_us = 0;
+    const UBaseType_t count = uxTaskGetSystemState(cpu_tasks, CPU_MAX_TASKS, &total_us);
+    const uint32_t elapsed_us = total_us - cpu_reported_us;
+    if (count == 0 || elapsed_us == 0) return;
+
+    // Work out each task's run time over the interval. A task created
+    // since the last report has run for all of its total
+    uint32_t interval_us[CPU_MAX_TASKS];
+    uint32_t idle_us = 0;
+    for (UBaseType_t i = 0 ; i < count ; ++i) {
+        uint32_t last_us = 0;
+        for (UBaseType_t j = 0 ; j < cpu_reported_count ; ++j) {
+            if (cpu_reported[j].number == cpu_tasks[i].xTaskNumber) {
+                last_us = cpu_reported[j].run_time_us;
+                break;
+            }
+        }
+
+        interval_us[i] = (uint32_t)cpu_tasks[i].ulRunTimeCounter - last_us;
+        if (strcmp(cpu_tasks[i].pcTaskName, configIDLE_TASK_NAME) == 0) idle_us = interval_us[i];
+    }
+
+    for (UBaseType_t i = 0 ; i < count ; ++i) {
+        cpu_reported[i].number = cpu_tasks[i].xTaskNumber;
+        cpu_reported[i].run_time_us = (uint32_t)cpu_tasks[i].ulRunTimeCounter;
+    }
+
+    cpu_reported_count = count;
+    cpu_reported_us = total_us;
+
+    const uint32_t idle_tenths = cpu_tenths(idle_us, elapsed_us);
+    server_log("CPU over %lus: idle %lu.%lu%%", (unsigned long)((elapsed_us + 500000) / 1000000),
+               (unsigned long)(idle_tenths / 10), (unsigned long)(idle_tenths % 10));
+
+    for (UBaseType_t i = 0 ; i < count ; ++i) {
+        if (strcmp(cpu_tasks[i].pcTaskName, configIDLE_TASK_NAME) == 0) continue;
+        const uint32_t tenths = cpu_tenths(interval_us[i], elapsed_us);
+        server_report("CPU %s: %lu.%lu%%", cpu_tasks[i].pcTaskName, (unsigned long)(tenths / 10), (unsigned long)(tenths % 10));
+    }
+}
+
+
+/**
+ * @brief Work out a share of an interval.
+ *
+ * @param part_us:  The share, in microseconds.
+ * @param whole_us: The interval, in microseconds.
+ *
+ * @returns The share in tenths of a percent, rounded.
+ */
+static uint32_t cpu_tenths(uint32_t part_us, uint32_t whole_us) {
+
+    return (uint32_t)(((uint64_t)part_us * 1000 + whole_us / 2) / whole_us);
+}
@@ -0,0 +1,48 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef CPU_HEADER
+#define CPU_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+#define     CPU_STATS_INTERVAL_MS               60000
+
+// Tasks the report covers, including the idle and timer service tasks
+#define     CPU_MAX_TASKS                       12
+
+
+/*
+ * TYPES
+ */
+// A task's run-time counter at the last report
+typedef struct {
+    UBaseType_t number;
+    uint32_t    run_time_us;
+} CpuTaskTime;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void cpu_log_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // CPU_HEADER
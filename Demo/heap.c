@@ -0,0 +1,341 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+#ifndef HOST_BUILD
+#include <reent.h>
+#endif
+
+
+#if configSUPPORT_DYNAMIC_ALLOCATION == 1
+/*
+ * The linker's `--wrap` option, set in `CMakeLists.txt`, sends calls to the
+ * FreeRTOS heap's `pvPortMalloc()` and `vPortFree()` here, as well as, on the
+ * board, calls to newlib's `malloc()` family. So every allocation comes from
+ * the FreeRTOS heap, and is counted against its call site: the address the
+ * allocation function was called from. Find the code with `addr2line`.
+ *
+ * On the host, only the FreeRTOS calls are wrapped: the C library's own
+ * threads allocate memory outside the scheduler.
+ */
+_Static_assert(sizeof(HeapHeader) % portBYTE_ALIGNMENT == 0, "HeapHeader must keep blocks aligned");
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static void*    heap_alloc(size_t size, uintptr_t caller);
+#ifndef HOST_BUILD
+static void*    heap_calloc(size_t count, size_t size, uintptr_t caller);
+static void*    heap_realloc(void* block, size_t size, uintptr_t caller);
+#endif
+static void     heap_free(void* block);
+static uint32_t heap_site_index(uintptr_t caller);
+
+
+/*
+ * PROTOTYPES
+ */
+// The FreeRTOS heap's own functions, renamed by the linker
+void*   __real_pvPortMalloc(size_t size);
+void    __real_vPortFree(void* block);
+
+
+/*
+ * GLOBALS
+ */
+// Entry 0 counts allocations from call sites the table has no room for
+static HeapSite heap_sites[HEAP_MAX_SITES] = { 0 };
+static uint32_t heap_failures = 0;
+
+
+void* __wrap_pvPortMalloc(size_t size) {
+
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void __wrap_vPortFree(void* block) {
+
+    heap_free(block);
+}
+
+
+#ifndef HOST_BUILD
+void* __wrap_malloc(size_t size) {
+
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void* __wrap__malloc_r(struct _reent* reent, size_t size) {
+
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void* __wrap_calloc(size_t count, size_t size) {
+
+    return heap_calloc(count, size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void* __wrap__calloc_r(struct _reent* reent, size_t count, size_t size) {
+
+    return heap_calloc(count, size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void* __wrap_realloc(void* block, size_t size) {
+
+    return heap_realloc(block, size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void* __wrap__realloc_r(struct _reent* reent, void* block, size_t size) {
+
+    return heap_realloc(block, size, (uintptr_t)__builtin_return_address(0));
+}
+
+
+void __wrap_free(void* block) {
+
+    heap_free(block);
+}
+
+
+void __wrap__free_r(struct _reent* reent, void* block) {
+
+    heap_free(block);
+}
+
+
+/**
+ * @brief Make newlib's allocator safe to call from tasks, should any library
+ *        code reach it other than through the wrapped functions.
+ */
+void __malloc_lock(struct _reent* reent) {
+
+    vTaskSuspendAll();
+}
+
+
+void __malloc_unlock(struct _reent* reent) {
+
+    xTaskResumeAll();
+}
+#endif
+
+
+/**
+ * @brief Allocate a block from the FreeRTOS heap, and count it against
+ *        its call site.
+ *
+ * @param size:   The size in bytes.
+ * @param caller: The call site.
+ *
+ * @returns The block, or `NULL` if the heap has no room for it.
+ */
+static void* heap_alloc(size_t size, uintptr_t caller) {
+
+    if (size > UINT32_MAX - sizeof(HeapHeader)) return NULL;
+    HeapHeader* header = __real_pvPortMalloc(sizeof(HeapHeader) + size);
+
+    vTaskSuspendAll();
+    if (header == NULL) {
+        heap_failures++;
+    } else {
+        header->site = heap_site_index(caller);
+        header->size = (uint32_t)size;
+        heap_sites[header->site].allocations++;
+        heap_sites[header->site].live_bytes += header->size;
+    }
+    xTaskResumeAll();
+
+    return (header != NULL) ? (void*)(header + 1) : NULL;
+}
+
+
+#ifndef HOST_BUILD
+/**
+ * @brief Allocate a zeroed block for an array.
+ *
+ * @param count:  The number of items.
+ * @param size:   The size of an item in bytes.
+ * @param caller: The call site.
+ *
+ * @returns The block, or `NULL` if the heap has no room for it.
+ */
+static void* heap_calloc(size_t count, size_t size, uintptr_t caller) {
+
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* block = heap_alloc(count * size, caller);
+    if (block != NULL) memset(block, 0, count * size);
+    return block;
+}
+
+
+/**
+ * @brief Resize a block, which moves it to a new block of the new size.
+ *
+ * @param block:  The block, or `NULL` to allocate a new one.
+ * @param size:   The new size in bytes.
+ * @param caller: The call site.
+ *
+ * @returns The new block, or `NULL` if the heap has no room for it,
+ *          in which case the old block is left as it was.
+ */
+static void* heap_realloc(void* block, size_t size, uintptr_t caller) {
+
+    void* new_block = heap_alloc(size, caller);
+    if (block == NULL || new_block == NULL) return new_block;
+
+    const HeapHeader* header = (const HeapHeader*)block - 1;
+    memcpy(new_block, block, (header->size < size) ? header->size : size);
+    heap_free(block);
+    return new_block;
+}
+#endif
+
+
+/**
+ * @brief Return a block to the FreeRTOS heap, and count it against
+ *        the site which allocated it.
+ *
+ * @param block: The block, or `NULL`.
+ */
+static void heap_free(void* block) {
+
+    if (block == NULL) return;
+    HeapHeader* header = (HeapHeader*)block - 1;
+
+    vTaskSuspendAll();
+    heap_sites[header->site].frees++;
+    heap_sites[header->site].live_bytes -= header->size;
+    xTaskResumeAll();
+
+    __real_vPortFree(header);
+}
+
+
+/**
+ * @brief Find a call site's entry in the table, adding it if it's new.
+ *        Call with the scheduler suspended.
+ *
+ * @param caller: The call site.
+ *
+ * @returns The entry's index: 0 if the table is full.
+ */
+static uint32_t heap_site_index(uintptr_t caller) {
+
+    for (uint32_t i = 1 ; i < HEAP_MAX_SITES ; ++i) {
+        if (heap_sites[i].address == caller) return i;
+        if (heap_sites[i].address == 0) {
+            heap_sites[i].address = caller;
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Get the state of the FreeRTOS heap, which serves every allocation.
+ *        Fragmentation is the share of the free space outside the largest
+ *        free block, so 0% means any allocation up to the free space fits.
+ *
+ * @param telemetry: Where to write the state.
+ */
+void heap_get_telemetry(HeapTelemetry* telemetry) {
+
+    if (telemetry == NULL) return;
+
+    HeapStats_t stats;
+    vPortGetHeapStats(&stats);
+
+    telemetry->total_bytes = configTOTAL_HEAP_SIZE;
+    telemetry->free_bytes = stats.xAvailableHeapSpaceInBytes;
+    telemetry->min_free_bytes = stats.xMinimumEverFreeBytesRemaining;
+    telemetry->largest_free_block = stats.xSizeOfLargestFreeBlockInBytes;
+    telemetry->fragmentation_percent = (telemetry->free_bytes > 0)
+        ? 100 - (uint32_t)(((uint64_t)telemetry->largest_free_block * 100) / telemetry->free_bytes) : 0;
+    telemetry->allocations = stats.xNumberOfSuccessfulAllocations;
+    telemetry->frees = stats.xNumberOfSuccessfulFrees;
+    telemetry->failures = heap_failures;
+}
+
+
+/**
+ * @brief Get the allocation counts of each call site.
+ *
+ * @param sites:     Where to write the call sites' counts.
+ * @param max_sites: The number of entries `sites` holds.
+ *
+ * @returns The number of entries written.
+ */
+uint32_t heap_get_sites(HeapSite* sites, uint32_t max_sites) {
+
+    if (sites == NULL) return 0;
+
+    uint32_t count = 0;
+    vTaskSuspendAll();
+    for (uint32_t i = 0 ; i < HEAP_MAX_SITES && count < max_sites ; ++i) {
+        if (heap_sites[i].allocations > 0) sites[count++] = heap_sites[i];
+    }
+    xTaskResumeAll();
+    return count;
+}
+
+
+/**
+ * @brief Log the state of the heap, then each call site's counts. A site
+ *        whose live bytes have grown since the last report is marked, as
+ *        a possible leak.
+ */
+void heap_log_stats(void) {
+
+    HeapTelemetry telemetry;
+    heap_get_telemetry(&telemetry);
+    server_log("Heap: %lu of %lu bytes free (min %lu), largest block %lu, %lu%% fragmented, %lu failures",
+               (unsigned long)telemetry.free_bytes, (unsigned long)telemetry.total_bytes,
+               (unsigned long)telemetry.min_free_bytes, (unsigned long)telemetry.largest_free_block,
+               (unsigned long)telemetry.fragmentation_percent, (unsigned long)telemetry.failures);
+
+    for (uint32_t i = 0 ; i < HEAP_MAX_SITES ; ++i) {
+        vTaskSuspendAll();
+        const HeapSite site = heap_sites[i];
+        heap_sites[i].reported_bytes = site.live_bytes;
+        xTaskResumeAll();
+
+        if (site.allocations == 0) continue;
+        server_report("Heap site 0x%08lx: %lu allocs, %lu frees, %lu bytes live%s",
+                      (unsigned long)site.address, (unsigned long)site.allocations, (unsigned long)site.frees,
+                      (unsigned long)site.live_bytes, (site.live_bytes > site.reported_bytes) ? " (growing)" : "");
+    }
+}
+#else
+/*
+ * Without dynamic allocation there's no FreeRTOS heap: newlib allocates
+ * with `_sbrk()`, as it did before, and there's nothing to report.
+ */
+void heap_get_telemetry(HeapTelemetry* telemetry) {
+
+    if (telemetry != NULL) memset(telemetry, 0, sizeof(HeapTelemetry));
+}
+
+
+uint32_t heap_get_sites(HeapSite* sites, uint32_t max_sites) {
+
+    return 0;
+}
+
+
+void heap_log_stats(void) {
+}
+#endif
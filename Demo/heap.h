@@ -0,0 +1,71 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef HEAP_HEADER
+#define HEAP_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+#define     HEAP_STATS_INTERVAL_MS              300000
+
+// Call sites tracked. Allocations from further call sites are
+// counted against entry 0
+#define     HEAP_MAX_SITES                      16
+
+
+/*
+ * TYPES
+ */
+// Each block starts with this header, which records its call site and size.
+// It's a multiple of portBYTE_ALIGNMENT, so blocks stay aligned
+typedef struct {
+    uint32_t    site;
+    uint32_t    size;
+} HeapHeader;
+
+typedef struct {
+    uintptr_t   address;
+    uint32_t    allocations;
+    uint32_t    frees;
+    uint32_t    live_bytes;
+    uint32_t    reported_bytes;
+} HeapSite;
+
+typedef struct {
+    uint32_t    total_bytes;
+    uint32_t    free_bytes;
+    uint32_t    min_free_bytes;
+    uint32_t    largest_free_block;
+    uint32_t    fragmentation_percent;
+    uint32_t    allocations;
+    uint32_t    frees;
+    uint32_t    failures;
+} HeapTelemetry;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void        heap_get_telemetry(HeapTelemetry* telemetry);
+uint32_t    heap_get_sites(HeapSite* sites, uint32_t max_sites);
+void        heap_log_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // HEAP_HEADER
@@ -6,13 +6,32 @@
  * Licence: MIT
  *
  */
+#define LOG_MODULE LOG_MODULE_I2C
 #include "main.h"
 
 
+/*
+ * TYPES
+ */
+typedef struct {
+    TaskHandle_t    task;
+    uint8_t         priority;
+    I2C_ClientStats stats;
+} I2C_Client;
+
+
 /*
  * STATIC PROTOTYPES
  */
-static bool I2C_check(uint8_t addr);
+static uint8_t I2C_find_client(TaskHandle_t task);
+static HAL_StatusTypeDef I2C_execute(I2C_Transaction* transaction);
+static HAL_StatusTypeDef I2C_single_op(uint8_t type, uint8_t address, uint8_t reg, uint8_t* data, uint16_t length, uint32_t timeout_ms);
+static HAL_StatusTypeDef I2C_transfer(const I2C_Op* op, uint8_t address, uint32_t timeout_ms);
+static HAL_StatusTypeDef I2C_start_transfer(const I2C_Op* op, uint8_t address);
+static void I2C_complete(HAL_StatusTypeDef result);
+static void I2C_record(I2C_Transaction* transaction, uint32_t wait_us, uint32_t bus_us);
+static void I2C_log_stats(void);
+static void task_i2c(void* argument);
 
 
 /*
@@ -20,6 +39,26 @@ static bool I2C_check(uint8_t addr);
  */
 I2C_HandleTypeDef   i2c;
 
+// The task waiting on the current interrupt-driven transfer, and its outcome
+static TaskHandle_t                 i2c_waiting_task = NULL;
+static volatile HAL_StatusTypeDef   i2c_result = HAL_OK;
+
+// The bus manager: its task, its transaction queues (one per priority
+// class), and its clients. Only the bus manager uses `i2c` once it's running
+static TaskHandle_t     handle_task_i2c = NULL;
+static QueueHandle_t    i2c_queues[I2C_PRIORITY_COUNT] = { NULL };
+static TickType_t       i2c_stats_tick = 0;
+static I2C_Client       i2c_clients[I2C_MAX_CLIENTS] = {
+    [0] = { .priority = I2C_PRIORITY_NORMAL, .stats = { .name = "OTHER" } }
+};
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+static StackType_t      task_i2c_stack[I2C_TASK_STACK_SIZE];
+static StaticTask_t     task_i2c_tcb;
+static I2C_Transaction* i2c_queue_items[I2C_PRIORITY_COUNT][I2C_QUEUE_LENGTH];
+static StaticQueue_t    i2c_queue_storage[I2C_PRIORITY_COUNT];
+#endif
+
 
 /**
  * @brief Initialize STM32U585 I2C1.
@@ -49,44 +88,514 @@ bool I2C_init(void) {
         return false;
     }
 
-    // Check MCP9808's presence
-    return I2C_check(MCP9808_ADDR);
+    return true;
 }
 
 
 /**
- * @brief Check for presence of a known device by its I2C address.
+ * @brief Check for the presence of a device by its I2C address:
+ *        one attempt to address it, which it must acknowledge.
  *
- * @param target_address: The device's address.
+ * @param address: The device's 7-bit address.
  *
  * @returns `true` if the device is present, otherwise `false`.
  */
-static bool I2C_check(uint8_t target_address) {
+bool I2C_probe(uint8_t address) {
+
+    return (I2C_single_op(I2C_OP_PROBE, address, 0, NULL, 0, I2C_PROBE_TIMEOUT_MS) == HAL_OK);
+}
+
+
+/**
+ * @brief Create the bus manager task and its transaction queues.
+ *        Until it runs, transactions are run in the caller's context.
+ *
+ * @returns `pdPASS` if the task was created, otherwise an error code.
+ */
+BaseType_t I2C_create_task(void) {
+
+    for (uint8_t i = 0 ; i < I2C_PRIORITY_COUNT ; ++i) {
+#if configSUPPORT_STATIC_ALLOCATION == 1
+        i2c_queues[i] = xQueueCreateStatic(I2C_QUEUE_LENGTH, sizeof(I2C_Transaction*),
+                                           (uint8_t*)i2c_queue_items[i], &i2c_queue_storage[i]);
+#else
+        i2c_queues[i] = xQueueCreate(I2C_QUEUE_LENGTH, sizeof(I2C_Transaction*));
+#endif
+        if (i2c_queues[i] == NULL) return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    handle_task_i2c = xTaskCreateStatic(task_i2c, "I2C_TASK", I2C_TASK_STACK_SIZE, NULL, I2C_TASK_PRIORITY, task_i2c_stack, &task_i2c_tcb);
+    return (handle_task_i2c != NULL) ? pdPASS : pdFAIL;
+#else
+    return xTaskCreate(task_i2c, "I2C_TASK", I2C_TASK_STACK_SIZE, NULL, I2C_TASK_PRIORITY, &handle_task_i2c);
+#endif
+}
+
+
+/**
+ * @brief Register a task as a bus manager client, so its transactions
+ *        get the client's priority class and statistics.
+ *        Re-registering a task updates its name and priority class.
+ *
+ * @param task:     The client task, or `NULL` for the calling task.
+ * @param name:     The client name, for statistics reports.
+ * @param priority: The client's priority class, eg. `I2C_PRIORITY_HIGH`.
+ *
+ * @returns `true` if the client was registered, otherwise `false`.
+ */
+bool I2C_register_client(TaskHandle_t task, const char* name, uint8_t priority) {
+
+    if (priority >= I2C_PRIORITY_COUNT) return false;
+    if (task == NULL) task = xTaskGetCurrentTaskHandle();
+
+    bool registered = false;
+    taskENTER_CRITICAL();
+    for (uint8_t i = 1 ; i < I2C_MAX_CLIENTS ; ++i) {
+        if (i2c_clients[i].task == task || i2c_clients[i].task == NULL) {
+            i2c_clients[i].stats.name = name;
+            i2c_clients[i].priority = priority;
+            i2c_clients[i].task = task;
+            registered = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if (!registered) server_error("No room to register I2C client %s", name);
+    return registered;
+}
+
+
+/**
+ * @brief Get a client's bus statistics.
+ *
+ * @param client: The client index: 0 for unregistered tasks, then
+ *                registered clients in the order they registered.
+ * @param stats:  Where to write the statistics.
+ *
+ * @returns `true` if the client exists, otherwise `false`.
+ */
+bool I2C_get_client_stats(uint8_t client, I2C_ClientStats* stats) {
+
+    if (client >= I2C_MAX_CLIENTS || stats == NULL || i2c_clients[client].stats.name == NULL) return false;
+    *stats = i2c_clients[client].stats;
+    return true;
+}
+
+
+/**
+ * @brief Run a transaction, blocking the calling task until it completes.
+ *
+ *        Once the bus manager is running, the transaction is queued for it
+ *        in the client's priority class, and the bus manager wakes the
+ *        caller with a notification on `I2C_NOTIFY_INDEX` when it's done.
+ *        Before then, the transaction is run in the caller's context.
+ *
+ * @param transaction: The transaction. Its memory must stay valid until
+ *                     the call returns, so it can live on the caller's stack.
+ *
+ * @returns The HAL status of the transaction.
+ */
+HAL_StatusTypeDef I2C_run(I2C_Transaction* transaction) {
+
+    if (transaction == NULL || transaction->op_count == 0 || transaction->op_count > I2C_MAX_OPS) return HAL_ERROR;
+
+    TaskHandle_t task = (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) ? xTaskGetCurrentTaskHandle() : NULL;
+    if (handle_task_i2c == NULL || task == NULL || task == handle_task_i2c) {
+        transaction->status = I2C_execute(transaction);
+        return transaction->status;
+    }
+
+    transaction->client_task = task;
+    transaction->client = I2C_find_client(task);
+    transaction->queued_us = timestamp_us();
+
+    // Clear any stale completion before we wait for this one
+    xTaskNotifyStateClearIndexed(NULL, I2C_NOTIFY_INDEX);
+    ulTaskNotifyValueClearIndexed(NULL, I2C_NOTIFY_INDEX, 0xFFFFFFFF);
+
+    const uint8_t priority = i2c_clients[transaction->client].priority;
+    if (xQueueSend(i2c_queues[priority], &transaction, pdMS_TO_TICKS(transaction->timeout_ms)) != pdPASS) {
+        return HAL_BUSY;
+    }
+
+    xTaskNotifyGive(handle_task_i2c);
+
+    // The bus manager always completes the transaction: each operation has a timeout
+    ulTaskNotifyTakeIndexed(I2C_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+    return transaction->status;
+}
+
+
+/**
+ * @brief Write bytes to an I2C device.
+ *
+ * @param address:    The device's 7-bit address.
+ * @param data:       The bytes to write.
+ * @param length:     The number of bytes.
+ * @param timeout_ms: How long to wait for the transfer to complete.
+ *
+ * @returns The HAL status of the transfer.
+ */
+HAL_StatusTypeDef I2C_transmit(uint8_t address, uint8_t* data, uint16_t length, uint32_t timeout_ms) {
+
+    return I2C_single_op(I2C_OP_WRITE, address, 0, data, length, timeout_ms);
+}
 
-    uint8_t timeout_count = 0;
 
-    while(true) {
-        HAL_StatusTypeDef status = HAL_I2C_IsDeviceReady(&i2c, target_address << 1, 1, 100);
-        if (status == HAL_OK) {
-            return true;
+/**
+ * @brief Read bytes from an I2C device.
+ *
+ * @param address:    The device's 7-bit address.
+ * @param data:       Where to write the bytes.
+ * @param length:     The number of bytes.
+ * @param timeout_ms: How long to wait for the transfer to complete.
+ *
+ * @returns The HAL status of the transfer.
+ */
+HAL_StatusTypeDef I2C_receive(uint8_t address, uint8_t* data, uint16_t length, uint32_t timeout_ms) {
+
+    return I2C_single_op(I2C_OP_READ, address, 0, data, length, timeout_ms);
+}
+
+
+/**
+ * @brief Write bytes to a device register: the register address and
+ *        the bytes go out in a single frame.
+ *
+ * @param address:    The device's 7-bit address.
+ * @param reg:        The register address.
+ * @param data:       The bytes to write.
+ * @param length:     The number of bytes.
+ * @param timeout_ms: How long to wait for the transfer to complete.
+ *
+ * @returns The HAL status of the transfer.
+ */
+HAL_StatusTypeDef I2C_write_register(uint8_t address, uint8_t reg, uint8_t* data, uint16_t length, uint32_t timeout_ms) {
+
+    return I2C_single_op(I2C_OP_WRITE_REG, address, reg, data, length, timeout_ms);
+}
+
+
+/**
+ * @brief Read bytes from a device register: the register address is
+ *        written, then the bytes read after a repeated START, with no
+ *        STOP between them.
+ *
+ * @param address:    The device's 7-bit address.
+ * @param reg:        The register address.
+ * @param data:       Where to write the bytes.
+ * @param length:     The number of bytes.
+ * @param timeout_ms: How long to wait for the transfer to complete.
+ *
+ * @returns The HAL status of the transfer.
+ */
+HAL_StatusTypeDef I2C_read_register(uint8_t address, uint8_t reg, uint8_t* data, uint16_t length, uint32_t timeout_ms) {
+
+    return I2C_single_op(I2C_OP_READ_REG, address, reg, data, length, timeout_ms);
+}
+
+
+/**
+ * @brief Run a single-operation transaction.
+ *
+ * @returns The HAL status of the transaction.
+ */
+static HAL_StatusTypeDef I2C_single_op(uint8_t type, uint8_t address, uint8_t reg, uint8_t* data, uint16_t length, uint32_t timeout_ms) {
+
+    I2C_Transaction transaction = {
+        .address = address,
+        .op_count = 1,
+        .timeout_ms = timeout_ms,
+        .ops = { { .type = type, .reg = reg, .length = length, .data = data } }
+    };
+
+    return I2C_run(&transaction);
+}
+
+
+/**
+ * @brief Find the client a task registered as.
+ *
+ * @param task: The task.
+ *
+ * @returns The client index, or 0 for an unregistered task.
+ */
+static uint8_t I2C_find_client(TaskHandle_t task) {
+
+    for (uint8_t i = 1 ; i < I2C_MAX_CLIENTS ; ++i) {
+        if (i2c_clients[i].task == task) return i;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Run a transaction's operations on the bus, stopping at the first to fail.
+ *
+ * @param transaction: The transaction.
+ *
+ * @returns The HAL status of the last operation run.
+ */
+static HAL_StatusTypeDef I2C_execute(I2C_Transaction* transaction) {
+
+    HAL_StatusTypeDef status = HAL_OK;
+    for (uint8_t i = 0 ; i < transaction->op_count && status == HAL_OK ; ++i) {
+        status = I2C_transfer(&transaction->ops[i], transaction->address, transaction->timeout_ms);
+    }
+
+    return status;
+}
+
+
+/**
+ * @brief  Function implementing the bus manager task.
+ *         Runs queued transactions, high priority class first,
+ *         and wakes each client when its transaction is done.
+ *
+ * @param  argument: Not used
+ */
+static void task_i2c(void* argument) {
+
+    while (true) {
+        I2C_Transaction* transaction = NULL;
+        for (uint8_t i = 0 ; i < I2C_PRIORITY_COUNT && transaction == NULL ; ++i) {
+            if (xQueueReceive(i2c_queues[i], &transaction, 0) != pdPASS) transaction = NULL;
+        }
+
+        if (transaction == NULL) {
+            // Block until a client queues a transaction
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        const uint32_t start_us = timestamp_us();
+        transaction->status = I2C_execute(transaction);
+        I2C_record(transaction, start_us - transaction->queued_us, timestamp_us() - start_us);
+
+        // NOTE The transaction may be gone as soon as its client is woken
+        xTaskNotifyGiveIndexed(transaction->client_task, I2C_NOTIFY_INDEX);
+
+        if (xTaskGetTickCount() - i2c_stats_tick >= pdMS_TO_TICKS(I2C_STATS_INTERVAL_MS)) {
+            i2c_stats_tick = xTaskGetTickCount();
+            I2C_log_stats();
+        }
+    }
+}
+
+
+/**
+ * @brief Add a completed transaction to its client's statistics.
+ *
+ * @param transaction: The transaction.
+ * @param wait_us:     How long the transaction was queued.
+ * @param bus_us:      How long the transaction took to run.
+ */
+static void I2C_record(I2C_Transaction* transaction, uint32_t wait_us, uint32_t bus_us) {
+
+    I2C_ClientStats* stats = &i2c_clients[transaction->client].stats;
+    stats->transactions++;
+    if (transaction->status != HAL_OK) stats->errors++;
+    stats->total_wait_us += wait_us;
+    stats->total_bus_us += bus_us;
+    if (wait_us > stats->max_wait_us) stats->max_wait_us = wait_us;
+    if (bus_us > stats->max_bus_us) stats->max_bus_us = bus_us;
+}
+
+
+/**
+ * @brief Log each client's bus statistics.
+ */
+static void I2C_log_stats(void) {
+
+    for (uint8_t i = 0 ; i < I2C_MAX_CLIENTS ; ++i) {
+        const I2C_ClientStats* stats = &i2c_clients[i].stats;
+        if (stats->transactions == 0) continue;
+        server_report("I2C %s: %lu transactions, %lu errors, wait %lu/%lu us, bus %lu/%lu us (mean/max)",
+                   stats->name, (unsigned long)stats->transactions, (unsigned long)stats->errors,
+                   (unsigned long)(stats->total_wait_us / stats->transactions), (unsigned long)stats->max_wait_us,
+                   (unsigned long)(stats->total_bus_us / stats->transactions), (unsigned long)stats->max_bus_us);
+    }
+}
+
+
+/**
+ * @brief Run a transfer.
+ *        Once the scheduler is running, the transfer is interrupt-driven:
+ *        the calling task blocks on a notification, so other tasks run
+ *        while the bytes are on the bus, until the HAL's completion or
+ *        error callback wakes it. Before then, the HAL polls the peripheral.
+ *
+ * @param op:         The operation to run.
+ * @param address:    The device's 7-bit address.
+ * @param timeout_ms: How long to wait for the transfer to complete.
+ *
+ * @returns The HAL status of the transfer.
+ */
+static HAL_StatusTypeDef I2C_transfer(const I2C_Op* op, uint8_t address, uint32_t timeout_ms) {
+
+    // The HAL has no interrupt-driven probe, but a probe is only the
+    // address byte, so polling for it holds the bus manager briefly
+    if (op->type == I2C_OP_PROBE) {
+        return HAL_I2C_IsDeviceReady(&i2c, address << 1, 1, timeout_ms);
+    }
+
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        switch (op->type) {
+            case I2C_OP_READ:
+                return HAL_I2C_Master_Receive(&i2c, address << 1, op->data, op->length, timeout_ms);
+            case I2C_OP_WRITE_REG:
+                return HAL_I2C_Mem_Write(&i2c, address << 1, op->reg, I2C_MEMADD_SIZE_8BIT, op->data, op->length, timeout_ms);
+            case I2C_OP_READ_REG:
+                return HAL_I2C_Mem_Read(&i2c, address << 1, op->reg, I2C_MEMADD_SIZE_8BIT, op->data, op->length, timeout_ms);
+            default:
+                return HAL_I2C_Master_Transmit(&i2c, address << 1, op->data, op->length, timeout_ms);
+        }
+    }
+
+    // Clear any completion left over from a transfer that timed out
+    xTaskNotifyStateClearIndexed(NULL, I2C_NOTIFY_INDEX);
+    ulTaskNotifyValueClearIndexed(NULL, I2C_NOTIFY_INDEX, 0xFFFFFFFF);
+
+    taskENTER_CRITICAL();
+    i2c_waiting_task = xTaskGetCurrentTaskHandle();
+    i2c_result = HAL_ERROR;
+    taskEXIT_CRITICAL();
+
+    HAL_StatusTypeDef status = I2C_start_transfer(op, address);
+    if (status == HAL_OK) {
+        if (ulTaskNotifyTakeIndexed(I2C_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(timeout_ms)) > 0) {
+            status = i2c_result;
         } else {
-            uint32_t err = HAL_I2C_GetError(&i2c);
-            server_error("HAL_I2C_IsDeviceReady() : %i", status);
-            server_error("HAL_I2C_GetError():       %li", err);
+            // Stop the transfer. The abort completes from the interrupt,
+            // with a call to `HAL_I2C_AbortCpltCallback()`: until then the
+            // HAL rejects new transfers as busy, so wait for it. Drop any
+            // completion which arrived since the timeout first. The HAL
+            // can't abort a register transfer, and an abort may not finish,
+            // so reset the peripheral in either case
+            xTaskNotifyStateClearIndexed(NULL, I2C_NOTIFY_INDEX);
+            ulTaskNotifyValueClearIndexed(NULL, I2C_NOTIFY_INDEX, 0xFFFFFFFF);
+            if (HAL_I2C_Master_Abort_IT(&i2c, address << 1) != HAL_OK
+                || ulTaskNotifyTakeIndexed(I2C_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(I2C_ABORT_TIMEOUT_MS)) == 0) {
+                HAL_I2C_DeInit(&i2c);
+                HAL_I2C_Init(&i2c);
+            }
+
+            status = HAL_TIMEOUT;
         }
+    }
 
-        HAL_Delay(500);
-        timeout_count++;
-        if (timeout_count > 10) break;
+    taskENTER_CRITICAL();
+    i2c_waiting_task = NULL;
+    taskEXIT_CRITICAL();
+    return status;
+}
+
+
+/**
+ * @brief Start an interrupt-driven transfer.
+ *
+ * @param op:      The operation to run.
+ * @param address: The device's 7-bit address.
+ *
+ * @returns The HAL status of the transfer's start.
+ */
+static HAL_StatusTypeDef I2C_start_transfer(const I2C_Op* op, uint8_t address) {
+
+    switch (op->type) {
+        case I2C_OP_READ:
+            // Each plain transfer is a complete frame: START, address, data, STOP
+            return HAL_I2C_Master_Seq_Receive_IT(&i2c, address << 1, op->data, op->length, I2C_FIRST_AND_LAST_FRAME);
+        case I2C_OP_WRITE_REG:
+            return HAL_I2C_Mem_Write_IT(&i2c, address << 1, op->reg, I2C_MEMADD_SIZE_8BIT, op->data, op->length);
+        case I2C_OP_READ_REG:
+            return HAL_I2C_Mem_Read_IT(&i2c, address << 1, op->reg, I2C_MEMADD_SIZE_8BIT, op->data, op->length);
+        default:
+            return HAL_I2C_Master_Seq_Transmit_IT(&i2c, address << 1, op->data, op->length, I2C_FIRST_AND_LAST_FRAME);
     }
+}
+
+
+/**
+ * @brief Record the outcome of an interrupt-driven transfer and wake the
+ *        task waiting on it. Called from the HAL's I2C1 interrupt callbacks.
+ *
+ * @param result: The outcome of the transfer.
+ */
+static void I2C_complete(HAL_StatusTypeDef result) {
 
-    // Flash the LED ten times on device not ready
-    for (uint8_t i = 0 ; i < 10 ; ++i) {
-        HAL_GPIO_TogglePin(LED_GPIO_PORT, LED_GPIO_PIN);
-        HAL_Delay(100);
+    UBaseType_t saved_mask = taskENTER_CRITICAL_FROM_ISR();
+    TaskHandle_t task = i2c_waiting_task;
+    i2c_result = result;
+    taskEXIT_CRITICAL_FROM_ISR(saved_mask);
+
+    if (task != NULL) {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        vTaskNotifyGiveIndexedFromISR(task, I2C_NOTIFY_INDEX, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
     }
+}
+
+
+/**
+ * @brief HAL callbacks for the end of an interrupt-driven transfer, or of its abort.
+ *
+ * @param i2c: A HAL I2C_HandleTypeDef pointer to the I2C instance.
+ */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *i2c) {
+
+    I2C_complete(HAL_OK);
+}
+
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *i2c) {
+
+    I2C_complete(HAL_OK);
+}
+
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *i2c) {
+
+    I2C_complete(HAL_OK);
+}
+
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *i2c) {
+
+    I2C_complete(HAL_OK);
+}
+
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *i2c) {
+
+    I2C_complete(HAL_ERROR);
+}
 
-    return false;
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *i2c) {
+
+    I2C_complete(HAL_TIMEOUT);
+}
+
+
+/**
+ * @brief I2C1 interrupt handlers as specified by the STM32U5 HAL.
+ */
+void I2C1_EV_IRQHandler(void) {
+
+    TRACE_ISR_ENTER(I2C1_EV_IRQn);
+    HAL_I2C_EV_IRQHandler(&i2c);
+    TRACE_ISR_EXIT(I2C1_EV_IRQn);
+}
+
+
+void I2C1_ER_IRQHandler(void) {
+
+    TRACE_ISR_ENTER(I2C1_ER_IRQn);
+    HAL_I2C_ER_IRQHandler(&i2c);
+    TRACE_ISR_EXIT(I2C1_ER_IRQn);
 }
 
 
@@ -128,4 +637,10 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *i2c) {
 
     // Enable the I2C1 clock
     __HAL_RCC_I2C1_CLK_ENABLE();
+
+    // Enable the I2C1 event and error interrupts for interrupt-driven transfers
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
 }
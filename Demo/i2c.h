@@ -10,6 +10,91 @@
 #define I2C_HEADER
 
 
+/*
+ * CONSTANTS
+ */
+// Tasks wait for transfers on this task notification index,
+// leaving index 0 free for the task's own use
+#define     I2C_NOTIFY_INDEX                    1
+
+// I2C1 interrupts call FreeRTOS APIs, so must be no more urgent than
+// configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#define     I2C_IRQ_PRIORITY                    (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1)
+
+// Bus manager task. It spends most of its time blocked, so runs above
+// its clients, including the timer service task
+#define     I2C_TASK_STACK_SIZE                 512
+#define     I2C_TASK_PRIORITY                   (configTIMER_TASK_PRIORITY + 1)
+
+// Transaction priority classes: the bus manager takes every queued
+// high-priority transaction before any normal one
+#define     I2C_PRIORITY_HIGH                   0
+#define     I2C_PRIORITY_NORMAL                 1
+#define     I2C_PRIORITY_COUNT                  2
+
+// Pending transactions per priority class
+#define     I2C_QUEUE_LENGTH                    4
+
+// Operations per transaction
+#define     I2C_MAX_OPS                         4
+
+// Registered clients. Client 0 stands for unregistered tasks
+#define     I2C_MAX_CLIENTS                     4
+
+// Operation types. Register operations send the register address and
+// the data in one frame, with a repeated START before the data of a read.
+// A probe sends just the address, and succeeds if the device acknowledges
+#define     I2C_OP_WRITE                        0
+#define     I2C_OP_READ                         1
+#define     I2C_OP_WRITE_REG                    2
+#define     I2C_OP_READ_REG                     3
+#define     I2C_OP_PROBE                        4
+
+#define     I2C_STATS_INTERVAL_MS               60000
+
+// How long a probe waits for a device to acknowledge its address
+#define     I2C_PROBE_TIMEOUT_MS                10
+
+// How long a timed-out transfer's abort may take before the peripheral
+// is reset instead
+#define     I2C_ABORT_TIMEOUT_MS                5
+
+
+/*
+ * TYPES
+ */
+typedef struct {
+    uint8_t     type;
+    uint8_t     reg;
+    uint16_t    length;
+    uint8_t*    data;
+} I2C_Op;
+
+// A transaction: operations run on the bus back to back, stopping at the
+// first that fails. The bus manager sets `status` and the `client_`
+// fields; the other fields are set by the caller
+typedef struct {
+    uint8_t             address;
+    uint8_t             op_count;
+    uint32_t            timeout_ms;
+    I2C_Op              ops[I2C_MAX_OPS];
+    HAL_StatusTypeDef   status;
+    TaskHandle_t        client_task;
+    uint8_t             client;
+    uint32_t            queued_us;
+} I2C_Transaction;
+
+typedef struct {
+    const char*     name;
+    uint32_t        transactions;
+    uint32_t        errors;
+    uint32_t        total_wait_us;
+    uint32_t        max_wait_us;
+    uint32_t        total_bus_us;
+    uint32_t        max_bus_us;
+} I2C_ClientStats;
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -19,6 +104,17 @@ extern "C" {
  * PROTOTYPES
  */
 bool I2C_init(void);
+bool I2C_probe(uint8_t address);
+BaseType_t I2C_create_task(void);
+bool I2C_register_client(TaskHandle_t task, const char* name, uint8_t priority);
+bool I2C_get_client_stats(uint8_t client, I2C_ClientStats* stats);
+HAL_StatusTypeDef I2C_run(I2C_Transaction* transaction);
+HAL_StatusTypeDef I2C_transmit(uint8_t address, uint8_t* data, uint16_t length, uint32_t timeout_ms);
+HAL_StatusTypeDef I2C_receive(uint8_t address, uint8_t* data, uint16_t length, uint32_t timeout_ms);
+HAL_StatusTypeDef I2C_write_register(uint8_t address, uint8_t reg, uint8_t* data, uint16_t length, uint32_t timeout_ms);
+HAL_StatusTypeDef I2C_read_register(uint8_t address, uint8_t reg, uint8_t* data, uint16_t length, uint32_t timeout_ms);
+void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,105 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * GLOBALS
+ */
+static LatencyHistogram latency_histograms[LATENCY_STAGE_COUNT] = { 0 };
+
+static const char* stage_names[] = { "interrupt to LED", "re-check timer delay", "timer to check" };
+
+
+/**
+ * @brief Add a latency to a stage's histogram. Call from a task.
+ *
+ *        The alert path is timed with the core's cycle counter, from
+ *        `timestamp_cycles()`, except the timer stage, which spans the
+ *        timer's period and uses `timestamp_us()`.
+ *
+ * @param stage:      The stage, eg. `LATENCY_STAGE_LED`.
+ * @param latency_us: The latency in microseconds.
+ */
+void latency_record(uint8_t stage, uint32_t latency_us) {
+
+    if (stage >= LATENCY_STAGE_COUNT) return;
+
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && latency_us >= latency_bucket_limit_us(bucket)) bucket++;
+
+    taskENTER_CRITICAL();
+    LatencyHistogram* histogram = &latency_histograms[stage];
+    histogram->buckets[bucket]++;
+    if (histogram->count == 0 || latency_us < histogram->min_us) histogram->min_us = latency_us;
+    if (latency_us > histogram->max_us) histogram->max_us = latency_us;
+    histogram->total_us += latency_us;
+    histogram->count++;
+    taskEXIT_CRITICAL();
+}
+
+
+/**
+ * @brief Get a copy of a stage's histogram.
+ *
+ * @param stage:     The stage, eg. `LATENCY_STAGE_LED`.
+ * @param histogram: Where to write the histogram.
+ */
+void latency_get(uint8_t stage, LatencyHistogram* histogram) {
+
+    if (stage >= LATENCY_STAGE_COUNT || histogram == NULL) return;
+
+    taskENTER_CRITICAL();
+    *histogram = latency_histograms[stage];
+    taskEXIT_CRITICAL();
+}
+
+
+/**
+ * @brief Get the upper limit of a histogram bucket.
+ *
+ * @param bucket: The bucket.
+ *
+ * @returns The smallest latency, in microseconds, the bucket doesn't
+ *          count, or `UINT32_MAX` for the last bucket.
+ */
+uint32_t latency_bucket_limit_us(uint8_t bucket) {
+
+    return (bucket < LATENCY_BUCKETS - 1) ? (uint32_t)LATENCY_FIRST_BUCKET_US << bucket : UINT32_MAX;
+}
+
+
+/**
+ * @brief Log each stage's count, minimum, mean and maximum latency, then
+ *        each of its buckets which has counted a latency.
+ */
+void latency_log_stats(void) {
+
+    for (uint8_t stage = 0 ; stage < LATENCY_STAGE_COUNT ; ++stage) {
+        LatencyHistogram histogram;
+        latency_get(stage, &histogram);
+        if (histogram.count == 0) continue;
+
+        server_report("Latency %s: %lu alerts, min %lu us, mean %lu us, max %lu us", stage_names[stage],
+                      (unsigned long)histogram.count, (unsigned long)histogram.min_us,
+                      (unsigned long)(histogram.total_us / histogram.count), (unsigned long)histogram.max_us);
+
+        for (uint8_t bucket = 0 ; bucket < LATENCY_BUCKETS ; ++bucket) {
+            if (histogram.buckets[bucket] == 0) continue;
+            const uint32_t from_us = (bucket > 0) ? latency_bucket_limit_us(bucket - 1) : 0;
+            if (bucket < LATENCY_BUCKETS - 1) {
+                server_report("Latency %s: %lu-%lu us: %lu", stage_names[stage], (unsigned long)from_us,
+                              (unsigned long)(latency_bucket_limit_us(bucket) - 1), (unsigned long)histogram.buckets[bucket]);
+            } else {
+                server_report("Latency %s: %lu+ us: %lu", stage_names[stage], (unsigned long)from_us,
+                              (unsigned long)histogram.buckets[bucket]);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef LATENCY_HEADER
+#define LATENCY_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+// Stages of the alert path, each with its own histogram:
+//   LED:   from the ALERT interrupt to the alert task lighting the LED
+//   TIMER: how late the alert timer's first re-check callback ran,
+//          after its period, to the tick
+//   CHECK: from that callback to the sensor readings reaching the alert
+#define     LATENCY_STAGE_LED                   0
+#define     LATENCY_STAGE_TIMER                 1
+#define     LATENCY_STAGE_CHECK                 2
+#define     LATENCY_STAGE_COUNT                 3
+
+// Bucket 0 counts latencies under LATENCY_FIRST_BUCKET_US. Each bucket
+// after it is twice as wide as the one before, and the last counts
+// every latency beyond the others, ie. 131ms and over
+#define     LATENCY_BUCKETS                     16
+#define     LATENCY_FIRST_BUCKET_US             8
+
+
+/*
+ * TYPES
+ */
+typedef struct {
+    uint32_t    buckets[LATENCY_BUCKETS];
+    uint32_t    count;
+    uint32_t    min_us;
+    uint32_t    max_us;
+    uint64_t    total_us;
+} LatencyHistogram;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void        latency_record(uint8_t stage, uint32_t latency_us);
+void        latency_get(uint8_t stage, LatencyHistogram* histogram);
+uint32_t    latency_bucket_limit_us(uint8_t bucket);
+void        latency_log_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // LATENCY_HEADER
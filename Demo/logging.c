@@ -6,7 +6,41 @@
  * Licence: MIT
  *
  */
+#define LOG_MODULE LOG_MODULE_LOGGING
 #include "main.h"
+#include <stdatomic.h>
+
+
+/*
+ * TYPES
+ */
+// A slot in the log queue. `sequence` tells producers and the consumer
+// whose turn it is to use the slot -- see `log_claim_slot()`
+typedef struct {
+    atomic_uint     sequence;
+    TickType_t      queued_tick;
+    uint16_t        length;
+    uint8_t         flags;
+    char            text[LOG_MESSAGE_MAX_LEN_B];
+} LogSlot;
+
+// A call site's rate limit token bucket. `busy` keeps a task and an ISR
+// from updating the entry at the same time -- see `log_rate_check()`
+typedef struct {
+    _Atomic(const char*)    format_string;
+    atomic_flag             busy;
+    uint8_t                 spent;
+    uint32_t                refill_ms;
+    uint32_t                suppressed;
+} LogRateEntry;
+
+// The start of a slot which holds an ISR's message for the log task to
+// format. The arguments' values follow -- see `log_text_from_isr()`
+typedef struct {
+    const char*     format_string;
+    uint32_t        arg_types;
+    uint32_t        suppressed;
+} LogDeferred;
 
 
 /*
@@ -14,16 +48,87 @@
  */
 static void log_start(void);
 static void log_service_setup(void);
-static void post_log(bool is_err, char* format_string, va_list args);
+static void log_queued(bool from_isr);
+static bool log_rate_check(const char* format_string, uint32_t* suppressed);
+static LogRateEntry* log_rate_entry(const char* format_string);
+static LogSlot* log_claim_slot(uint32_t* pos, uint8_t flags);
+static void log_publish_slot(LogSlot* slot, uint32_t pos);
+static void log_drain(bool flush);
+static void log_output(const char* message, uint16_t length, TickType_t queued_tick, bool is_err);
+static void log_output_repeats(void);
+static void log_append(const char* message, uint16_t length, TickType_t queued_tick, bool is_err);
+static void log_flush(uint32_t* reason_count);
+static void log_report_batch_stats(void);
+static TickType_t log_batch_wait(void);
+static void task_log(void* argument);
+#if LOG_TOKENIZED
+static uint8_t* log_put_varint(uint8_t* out, uint8_t* end, int64_t value);
+#else
+static bool post_log(uint8_t flags, const char* format_string, va_list args);
+static uint16_t log_format_deferred(const LogSlot* slot, char* text);
+static uint16_t log_add_suppressed(char* text, uint16_t length, uint32_t suppressed);
+#endif
 
 
 /*
  * GLOBALS
  */
+// Runtime log levels, one per `LOG_MODULE_*`, capped by the compile-time levels
+uint8_t log_levels[LOG_MODULE_COUNT] = {
+    [LOG_MODULE_MAIN]       = LOG_LEVEL_MAIN,
+    [LOG_MODULE_I2C]        = LOG_LEVEL_I2C,
+    [LOG_MODULE_MCP9808]    = LOG_LEVEL_MCP9808,
+    [LOG_MODULE_LOGGING]    = LOG_LEVEL_LOGGING
+};
+
 // Entities for Microvisor application logging
 static uint8_t log_buffer[LOG_BUFFER_SIZE_B] __attribute__((aligned(512))) = {0};
 static uint32_t log_state = USER_HANDLE_LOGGING_OFF;
 
+// The log queue: a lock-free, multi-producer, single-consumer ring
+static LogSlot      log_queue[LOG_QUEUE_LENGTH];
+static atomic_uint  log_enqueue_pos = 0;
+static uint32_t     log_dequeue_pos = 0;
+static atomic_flag  log_drain_lock = ATOMIC_FLAG_INIT;
+static bool         log_queue_ready = false;
+
+// Messages lost to a full queue: since the last report, and in total
+static atomic_uint  log_dropped = 0;
+static atomic_uint  log_dropped_total = 0;
+
+// Call site rate limits, and messages suppressed by them in total
+static LogRateEntry log_rate_table[LOG_RATE_TABLE_SIZE];
+static atomic_uint  log_suppressed_total = 0;
+
+// The last message the log task output, and how often it has been repeated since
+static char         log_last[LOG_MESSAGE_MAX_LEN_B];
+static uint16_t     log_last_length = 0;
+static bool         log_last_is_err = false;
+static TickType_t   log_last_tick = 0;
+static uint32_t     log_repeat_count = 0;
+
+// The batch being built by the log task, and its statistics
+static char         log_batch[LOG_BATCH_MAX_B];
+static uint16_t     log_batch_length = 0;
+static uint32_t     log_batch_count = 0;
+static TickType_t   log_batch_oldest_tick = 0;
+static TickType_t   log_batch_stats_tick = 0;
+static LogBatchStats log_batch_stats = { 0 };
+
+// FreeRTOS task handle
+static TaskHandle_t handle_task_log = NULL;
+
+#if configSUPPORT_STATIC_ALLOCATION == 1
+static StackType_t  task_log_stack[LOG_TASK_STACK_SIZE];
+static StaticTask_t task_log_tcb;
+#endif
+
+#if LOG_TOKENIZED
+// Tokens are format string addresses relative to this constant, so they
+// are small, and fixed even when the host build is loaded at a random address
+const char log_token_base[1] __attribute__((used)) = { 0 };
+#endif
+
 // Entities for local serial logging
 // Declared in `uart_logging.c`
 #ifdef UART_LOGGING_H
@@ -40,6 +145,15 @@ static bool uart_available = false;
  */
 static void log_start(void) {
 
+    if (!log_queue_ready) {
+        // Mark every slot free for the first pass through the ring
+        for (uint32_t i = 0 ; i < LOG_QUEUE_LENGTH ; ++i) {
+            atomic_init(&log_queue[i].sequence, i);
+        }
+
+        log_queue_ready = true;
+    }
+
     if (log_state != USER_HANDLE_LOGGING_STARTED) {
         // Initiate the Microvisor logging service
         log_service_setup();
@@ -69,62 +183,872 @@ static void log_service_setup(void) {
 
 
 /**
- * @brief Issue a debug message.
+ * @brief Create the task which posts queued messages to Microvisor.
+ *        Until it runs, messages are posted in the caller's context.
+ *
+ * @returns `pdPASS` if the task was created, otherwise an error code.
+ */
+BaseType_t log_create_task(void) {
+
+    log_start();
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    handle_task_log = xTaskCreateStatic(task_log, "LOG_TASK", LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIORITY, task_log_stack, &task_log_tcb);
+    return (handle_task_log != NULL) ? pdPASS : pdFAIL;
+#else
+    return xTaskCreate(task_log, "LOG_TASK", LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIORITY, &handle_task_log);
+#endif
+}
+
+
+#if LOG_TOKENIZED
+_Static_assert(LOG_TOKEN_STRING_MAX_LEN_B < LOG_TOKEN_STRING_TRUNCATED, "LOG_TOKEN_STRING_MAX_LEN_B must fit beside the truncation flag");
+
+
+/**
+ * @brief Issue a tokenized message. Called by the `server_log()` family of
+ *        macros when `LOG_TOKENIZED` is set.
  *
+ *        The message is queued as a binary frame: a flags byte, the format
+ *        string's token, then each argument. Integers are zigzag-encoded
+ *        varints, floating-point values are 32-bit floats and strings are a
+ *        length byte and up to `LOG_TOKEN_STRING_MAX_LEN_B` characters. The
+ *        length byte of a string which was cut short, to that limit or to
+ *        fit the frame, has `LOG_TOKEN_STRING_TRUNCATED` set.
+ *        If `LOG_FLAG_SUPPRESSED` is set, a varint count of messages
+ *        suppressed by the call site's rate limit comes last.
+ *        `Tools/log_decoder.py` reads the format strings from the ELF
+ *        to turn frames back into text.
+ *
+ * @param flags         `LOG_FLAG_ERROR`, `LOG_FLAG_UNLIMITED` and/or `LOG_FLAG_FROM_ISR`
  * @param format_string Message string with optional formatting
+ * @param arg_types     Argument count and types, from `LOG_ARG_TYPES()`
  * @param ...           Optional injectable values
  */
-void server_log(char* format_string, ...) {
+void log_tokenized(uint8_t flags, const char* format_string, uint32_t arg_types, ...) {
+
+    log_start();
+
+    uint32_t suppressed = 0;
+    if ((flags & LOG_FLAG_UNLIMITED) == 0 && !log_rate_check(format_string, &suppressed)) return;
 
-    if (LOG_DEBUG_MESSAGES) {
-        va_list args;
-        va_start(args, format_string);
-        post_log(false, format_string, args);
-        va_end(args);
+    uint32_t pos;
+    LogSlot* slot = log_claim_slot(&pos, flags);
+    if (slot == NULL) return;
+
+    // A count of suppressed messages follows the arguments:
+    // keep room for its varint
+    uint8_t* out = (uint8_t*)slot->text;
+    uint8_t* end = out + sizeof(slot->text) - (suppressed > 0 ? 5 : 0);
+    *out++ = (flags & LOG_FLAG_ERROR) | (suppressed > 0 ? LOG_FLAG_SUPPRESSED : 0);
+    out = log_put_varint(out, end, (int32_t)((uintptr_t)format_string - (uintptr_t)log_token_base));
+
+    va_list args;
+    va_start(args, arg_types);
+    const uint32_t arg_count = arg_types & 0x0F;
+    for (uint32_t i = 0 ; i < arg_count ; ++i) {
+        switch ((arg_types >> (4 + 3 * i)) & 0x07) {
+            case LOG_ARG_LONG:
+                out = log_put_varint(out, end, va_arg(args, long));
+                break;
+            case LOG_ARG_LLONG:
+                out = log_put_varint(out, end, va_arg(args, long long));
+                break;
+            case LOG_ARG_DOUBLE:
+            {
+                float value = (float)va_arg(args, double);
+                if (end - out >= (int)sizeof(value)) {
+                    memcpy(out, &value, sizeof(value));
+                    out += sizeof(value);
+                }
+                break;
+            }
+            case LOG_ARG_STRING:
+            {
+                const char* value = va_arg(args, const char*);
+                size_t length = (value != NULL) ? strnlen(value, LOG_TOKEN_STRING_MAX_LEN_B + 1) : 0;
+                bool is_truncated = (length > LOG_TOKEN_STRING_MAX_LEN_B);
+                if (is_truncated) length = LOG_TOKEN_STRING_MAX_LEN_B;
+                if (end - out < (int)length + 1) {
+                    length = (end - out > 0) ? (size_t)(end - out - 1) : 0;
+                    is_truncated = true;
+                }
+                if (end - out > 0) {
+                    *out++ = (uint8_t)length | (is_truncated ? LOG_TOKEN_STRING_TRUNCATED : 0);
+                    memcpy(out, value, length);
+                    out += length;
+                }
+                break;
+            }
+            default:
+                out = log_put_varint(out, end, va_arg(args, int));
+                break;
+        }
     }
+
+    va_end(args);
+    if (suppressed > 0) out = log_put_varint(out, end + 5, suppressed);
+    slot->length = (uint16_t)(out - (uint8_t*)slot->text);
+    log_publish_slot(slot, pos);
+    log_queued((flags & LOG_FLAG_FROM_ISR) != 0);
 }
 
 
 /**
- * @brief Issue an error message.
+ * @brief Write a value as a zigzag-encoded, little-endian base-128 varint.
+ *
+ * @param out   Where to write the varint
+ * @param end   The end of the buffer
+ * @param value The value to write
+ *
+ * @returns The next free byte in the buffer.
+ */
+static uint8_t* log_put_varint(uint8_t* out, uint8_t* end, int64_t value) {
+
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    do {
+        if (out >= end) break;
+        uint8_t byte = zigzag & 0x7F;
+        zigzag >>= 7;
+        *out++ = byte | (zigzag != 0 ? 0x80 : 0);
+    } while (zigzag != 0);
+
+    return out;
+}
+#else
+/**
+ * @brief Issue a message. Called by the `server_log()` family of macros,
+ *        except from ISRs: see `log_text_from_isr()`.
  *
+ * @param flags         `LOG_FLAG_ERROR`, `LOG_FLAG_UNLIMITED` and/or `LOG_FLAG_FROM_ISR`
  * @param format_string Message string with optional formatting
  * @param ...           Optional injectable values
  */
-void server_error(char* format_string, ...) {
+void log_text(uint8_t flags, const char* format_string, ...) {
 
     va_list args;
     va_start(args, format_string);
-    post_log(true, format_string, args);
+    bool queued = post_log(flags, format_string, args);
     va_end(args);
+    if (queued) log_queued((flags & LOG_FLAG_FROM_ISR) != 0);
 }
 
 
 /**
- * @brief Issue any log message.
+ * @brief Format a log message into the next free queue slot.
  *
- * @param is_err        Is the message an error?
+ * @param flags         `LOG_FLAG_ERROR`, `LOG_FLAG_UNLIMITED` and/or `LOG_FLAG_FROM_ISR`
  * @param format_string Message string with optional formatting
  * @param args          va_list of args from previous call
+ *
+ * @returns `true` if the message was queued, `false` if the queue was full.
  */
-static void post_log(bool is_err, char* format_string, va_list args) {
+static bool post_log(uint8_t flags, const char* format_string, va_list args) {
 
     log_start();
-    static char buffer[LOG_MESSAGE_MAX_LEN_B] = {0};
+
+    // Check the call site's rate limit before doing any formatting
+    uint32_t suppressed = 0;
+    if ((flags & LOG_FLAG_UNLIMITED) == 0 && !log_rate_check(format_string, &suppressed)) return false;
+
+    uint32_t pos;
+    LogSlot* slot = log_claim_slot(&pos, flags);
+    if (slot == NULL) return false;
 
     // Write the message type to the message
-    sprintf(buffer, is_err ? "[ERROR] " : "[DEBUG] ");
+    strcpy(slot->text, (flags & LOG_FLAG_ERROR) ? "[ERROR] " : "[DEBUG] ");
 
     // Write the formatted text to the message
-    vsnprintf(&buffer[8], sizeof(buffer) - 9, format_string, args);
+    int length = vsnprintf(&slot->text[8], sizeof(slot->text) - 8, format_string, args);
+    if (length < 0) length = 0;
+    if (length > (int)sizeof(slot->text) - 9) length = sizeof(slot->text) - 9;
+    length += 8;
+
+    slot->length = log_add_suppressed(slot->text, (uint16_t)length, suppressed);
+
+    log_publish_slot(slot, pos);
+    return true;
+}
+
+
+/**
+ * @brief Issue a message from an ISR. Called by the `server_log_from_isr()`
+ *        family of macros.
+ *
+ *        Formatting a message is slow, so the ISR queues only the format
+ *        string's address and a copy of each argument's value, and the log
+ *        task formats the message -- see `log_format_deferred()`. Strings
+ *        are copied, as an ISR's buffers may not outlive it, and any
+ *        arguments which don't fit the slot are left out.
+ *        NOTE `*` widths and precisions are not supported in ISR messages.
+ *
+ * @param flags         `LOG_FLAG_ERROR` and/or `LOG_FLAG_UNLIMITED`, and `LOG_FLAG_FROM_ISR`
+ * @param format_string Message string with optional formatting
+ * @param arg_types     Argument count and types, from `LOG_ARG_TYPES()`
+ * @param ...           Optional injectable values
+ */
+void log_text_from_isr(uint8_t flags, const char* format_string, uint32_t arg_types, ...) {
+
+    log_start();
+
+    uint32_t suppressed = 0;
+    if ((flags & LOG_FLAG_UNLIMITED) == 0 && !log_rate_check(format_string, &suppressed)) return;
+
+    uint32_t pos;
+    LogSlot* slot = log_claim_slot(&pos, flags | LOG_FLAG_DEFERRED);
+    if (slot == NULL) return;
+
+    uint8_t* out = (uint8_t*)slot->text + sizeof(LogDeferred);
+    uint8_t* end = (uint8_t*)slot->text + sizeof(slot->text);
+    uint32_t stored = 0;
+
+    va_list args;
+    va_start(args, arg_types);
+    const uint32_t arg_count = arg_types & 0x0F;
+    for ( ; stored < arg_count ; ++stored) {
+        union { int i; long l; long long ll; double d; } value;
+        const void* data = &value;
+        size_t size;
+        switch ((arg_types >> (4 + 3 * stored)) & 0x07) {
+            case LOG_ARG_LONG:
+                value.l = va_arg(args, long);
+                size = sizeof(value.l);
+                break;
+            case LOG_ARG_LLONG:
+                value.ll = va_arg(args, long long);
+                size = sizeof(value.ll);
+                break;
+            case LOG_ARG_DOUBLE:
+                value.d = va_arg(args, double);
+                size = sizeof(value.d);
+                break;
+            case LOG_ARG_STRING:
+                data = va_arg(args, const char*);
+                if (data == NULL) data = "(null)";
+                size = strnlen(data, (end - out > 0) ? (size_t)(end - out - 1) : 0);
+                break;
+            default:
+                value.i = va_arg(args, int);
+                size = sizeof(value.i);
+        }
+
+        // Strings take a NUL terminator, and are cut short to fit
+        const bool is_string = (data != &value);
+        if (end - out < (int)size + (is_string ? 1 : 0)) break;
+        memcpy(out, data, size);
+        out += size;
+        if (is_string) *out++ = '\0';
+    }
+
+    va_end(args);
+
+    // Record how many arguments were stored
+    const LogDeferred header = { format_string, (arg_types & ~0x0Fu) | stored, suppressed };
+    memcpy(slot->text, &header, sizeof(header));
+    slot->length = (uint16_t)(out - (uint8_t*)slot->text);
+    log_publish_slot(slot, pos);
+    log_queued(true);
+}
+
+
+/**
+ * @brief Format a message queued by `log_text_from_isr()`. Called by the
+ *        log task. Each conversion is formatted on its own, with the value
+ *        stored for it.
+ *
+ * @param slot The slot holding the message
+ * @param text Where to write the message: must hold `LOG_MESSAGE_MAX_LEN_B` bytes
+ *
+ * @returns The length of the message.
+ */
+static uint16_t log_format_deferred(const LogSlot* slot, char* text) {
+
+    LogDeferred header;
+    memcpy(&header, slot->text, sizeof(header));
+    const char* in = slot->text + sizeof(header);
+    const uint32_t arg_count = header.arg_types & 0x0F;
+    uint32_t arg = 0;
+
+    strcpy(text, (slot->flags & LOG_FLAG_ERROR) ? "[ERROR] " : "[DEBUG] ");
+    size_t length = 8;
+    for (const char* format = header.format_string ; *format != '\0' && length < LOG_MESSAGE_MAX_LEN_B - 1 ; ++format) {
+        if (*format != '%') {
+            text[length++] = *format;
+            continue;
+        }
+
+        // Copy the conversion: flags, width, precision, length modifier and type
+        char spec[16];
+        size_t spec_length = 0;
+        spec[spec_length++] = *format++;
+        while (*format != '\0' && strchr("-+ #0123456789.hljztL", *format) != NULL && spec_length < sizeof(spec) - 2) {
+            spec[spec_length++] = *format++;
+        }
+
+        if (*format == '\0') break;
+        if (*format == '%') {
+            text[length++] = '%';
+            continue;
+        }
+
+        spec[spec_length++] = *format;
+        spec[spec_length] = '\0';
+        if (arg == arg_count) break;
+
+        const size_t room = LOG_MESSAGE_MAX_LEN_B - length;
+        int written = 0;
+        switch ((header.arg_types >> (4 + 3 * arg++)) & 0x07) {
+            case LOG_ARG_LONG:
+            {
+                long value;
+                memcpy(&value, in, sizeof(value));
+                in += sizeof(value);
+                written = snprintf(&text[length], room, spec, value);
+                break;
+            }
+            case LOG_ARG_LLONG:
+            {
+                long long value;
+                memcpy(&value, in, sizeof(value));
+                in += sizeof(value);
+                written = snprintf(&text[length], room, spec, value);
+                break;
+            }
+            case LOG_ARG_DOUBLE:
+            {
+                double value;
+                memcpy(&value, in, sizeof(value));
+                in += sizeof(value);
+                written = snprintf(&text[length], room, spec, value);
+                break;
+            }
+            case LOG_ARG_STRING:
+                written = snprintf(&text[length], room, spec, in);
+                in += strlen(in) + 1;
+                break;
+            default:
+            {
+                int value;
+                memcpy(&value, in, sizeof(value));
+                in += sizeof(value);
+                written = snprintf(&text[length], room, spec, value);
+            }
+        }
+
+        if (written > 0) length += ((size_t)written < room) ? (size_t)written : room - 1;
+    }
+
+    text[length] = '\0';
+    return log_add_suppressed(text, (uint16_t)length, header.suppressed);
+}
+
+
+/**
+ * @brief Add the count of messages the rate limit held back, at the
+ *        expense of the end of the message if need be.
+ *
+ * @param text       The message, in a `LOG_MESSAGE_MAX_LEN_B` buffer
+ * @param length     The message length in bytes
+ * @param suppressed The count, or 0 to leave the message as it is
+ *
+ * @returns The new length of the message.
+ */
+static uint16_t log_add_suppressed(char* text, uint16_t length, uint32_t suppressed) {
+
+    if (suppressed == 0) return length;
+
+    char suffix[24];
+    int suffix_length = snprintf(suffix, sizeof(suffix), " [%lu suppressed]", (unsigned long)suppressed);
+    if (length + suffix_length > LOG_MESSAGE_MAX_LEN_B - 1) length = LOG_MESSAGE_MAX_LEN_B - 1 - suffix_length;
+    memcpy(&text[length], suffix, suffix_length + 1);
+    return length + suffix_length;
+}
+#endif
+
+
+/**
+ * @brief Base64-encode binary data so it can travel as a log message.
+ *
+ * @param data   The data
+ * @param length The data length in bytes
+ * @param out    Where to write the text: must hold 4 * ((length + 2) / 3) bytes
+ *
+ * @returns The length of the text.
+ */
+uint16_t log_base64(const uint8_t* data, uint16_t length, char* out) {
+
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char* start = out;
+    for (uint16_t i = 0 ; i < length ; i += 3) {
+        uint32_t triple = (uint32_t)data[i] << 16;
+        if (i + 1 < length) triple |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length) triple |= data[i + 2];
+        *out++ = alphabet[(triple >> 18) & 0x3F];
+        *out++ = alphabet[(triple >> 12) & 0x3F];
+        *out++ = (i + 1 < length) ? alphabet[(triple >> 6) & 0x3F] : '=';
+        *out++ = (i + 2 < length) ? alphabet[triple & 0x3F] : '=';
+    }
+
+    return (uint16_t)(out - start);
+}
+
+
+/**
+ * @brief Never called: gives log calls printf format checking.
+ */
+void log_format_check(const char* format_string, ...) {
+
+    // NOP
+}
+
+
+/**
+ * @brief Set a module's log level at runtime.
+ *        Calls above the module's compile-time level are not in the
+ *        build, so the level can be lowered and restored, not raised.
+ *
+ * @param module A `LOG_MODULE_*` value
+ * @param level  A `LOG_LEVEL_*` value
+ */
+void log_set_level(uint8_t module, uint8_t level) {
+
+    if (module < LOG_MODULE_COUNT) log_levels[module] = level;
+}
+
+
+/**
+ * @brief Get a module's runtime log level.
+ *
+ * @param module A `LOG_MODULE_*` value
+ *
+ * @returns The level, or `LOG_LEVEL_NONE` for an unknown module.
+ */
+uint8_t log_get_level(uint8_t module) {
+
+    return module < LOG_MODULE_COUNT ? log_levels[module] : LOG_LEVEL_NONE;
+}
+
+
+/**
+ * @brief Get a newly queued message posted: inline if the scheduler
+ *        has yet to start, otherwise by waking the log task.
+ *
+ * @param from_isr Are we in an interrupt handler?
+ */
+static void log_queued(bool from_isr) {
+
+    if (from_isr) {
+        if (handle_task_log != NULL) {
+            BaseType_t higher_priority_task_woken = pdFALSE;
+            vTaskNotifyGiveFromISR(handle_task_log, &higher_priority_task_woken);
+            portYIELD_FROM_ISR(higher_priority_task_woken);
+        }
+    } else if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) {
+        // Batch the message now. The log task will post the batch when
+        // the scheduler starts, unless it fills up before then
+        log_drain(false);
+    } else if (handle_task_log != NULL) {
+        xTaskNotifyGive(handle_task_log);
+    }
+}
 
-    // Output the message using the system call
-    mvServerLog((const uint8_t*)buffer, (uint16_t)strlen(buffer));
+
+/**
+ * @brief Apply a call site's rate limit to a new message.
+ *
+ *        Each call site has a token bucket: a message spends a token, and
+ *        tokens come back at one every `LOG_RATE_REFILL_MS`, up to
+ *        `LOG_RATE_BURST`. Messages with no token to spend are counted.
+ *        If a task is updating the bucket when an ISR logs from the same
+ *        call site, the ISR's message is let through rather than wait.
+ *
+ * @param format_string The call site's format string
+ * @param suppressed    Where to write the number of messages suppressed
+ *                      since the call site's last message got through
+ *
+ * @returns `true` if the message should be queued, otherwise `false`.
+ */
+static bool log_rate_check(const char* format_string, uint32_t* suppressed) {
+
+    LogRateEntry* entry = log_rate_entry(format_string);
+    if (entry == NULL) return true;
+    if (atomic_flag_test_and_set_explicit(&entry->busy, memory_order_acquire)) return true;
+
+    // Return the tokens earned since the last refill.
+    // `HAL_GetTick()` runs before the scheduler starts, unlike the RTOS tick
+    const uint32_t now = HAL_GetTick();
+    if (entry->spent == 0) {
+        entry->refill_ms = now;
+    } else {
+        const uint32_t earned = (now - entry->refill_ms) / LOG_RATE_REFILL_MS;
+        if (earned > 0) {
+            entry->spent = earned >= entry->spent ? 0 : entry->spent - earned;
+            entry->refill_ms += earned * LOG_RATE_REFILL_MS;
+        }
+    }
+
+    const bool allowed = entry->spent < LOG_RATE_BURST;
+    if (allowed) {
+        entry->spent++;
+        *suppressed = entry->suppressed;
+        entry->suppressed = 0;
+    } else {
+        entry->suppressed++;
+        atomic_fetch_add_explicit(&log_suppressed_total, 1, memory_order_relaxed);
+    }
+
+    atomic_flag_clear_explicit(&entry->busy, memory_order_release);
+    return allowed;
+}
+
+
+/**
+ * @brief Find, or add, a call site's rate limit entry.
+ *        Entries are never removed: the table is open-addressed, keyed
+ *        by format string address, with short linear probing.
+ *
+ * @param format_string The call site's format string
+ *
+ * @returns The entry, or `NULL` if there's no room for it -- the call
+ *          site is then not rate limited.
+ */
+static LogRateEntry* log_rate_entry(const char* format_string) {
+
+    uint32_t index = ((uint32_t)(uintptr_t)format_string * 2654435761u) >> 16;
+    for (uint32_t i = 0 ; i < LOG_RATE_MAX_PROBES ; ++i) {
+        LogRateEntry* entry = &log_rate_table[(index + i) & (LOG_RATE_TABLE_SIZE - 1)];
+        const char* key = atomic_load_explicit(&entry->format_string, memory_order_acquire);
+        if (key == NULL) {
+            // Claim the free entry, unless another caller just took it
+            if (atomic_compare_exchange_strong_explicit(&entry->format_string, &key, format_string,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                return entry;
+            }
+        }
+
+        if (key == format_string) return entry;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Claim the next free queue slot.
+ *
+ *        Each slot's sequence number equals the producer position which
+ *        may claim it when it's free, and that position + 1 once it holds
+ *        a message. A producer claims a slot by advancing the shared
+ *        position with a compare-and-swap, so tasks and ISRs never wait on
+ *        each other, and fills the slot before publishing it to the
+ *        consumer -- based on Dmitry Vyukov's bounded MPMC queue.
+ *
+ * @param pos   Where to write the claimed position, for `log_publish_slot()`
+ * @param flags `LOG_FLAG_ERROR` and/or `LOG_FLAG_FROM_ISR`
+ *
+ * @returns The slot, or `NULL` if the queue was full.
+ */
+static LogSlot* log_claim_slot(uint32_t* pos, uint8_t flags) {
+
+    uint32_t claim = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+    while (true) {
+        LogSlot* slot = &log_queue[claim & (LOG_QUEUE_LENGTH - 1)];
+        uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int32_t diff = (int32_t)(sequence - claim);
+        if (diff == 0) {
+            // Slot is free -- try to claim it
+            if (atomic_compare_exchange_weak_explicit(&log_enqueue_pos, &claim, claim + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *pos = claim;
+                slot->flags = flags;
+                slot->queued_tick = (flags & LOG_FLAG_FROM_ISR) ? xTaskGetTickCountFromISR() : xTaskGetTickCount();
+                return slot;
+            }
+        } else if (diff < 0) {
+            // Slot still holds an unposted message: the queue is full
+            atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&log_dropped_total, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            // Another producer got here first
+            claim = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+
+/**
+ * @brief Hand a filled slot to the consumer.
+ *
+ * @param slot The slot from `log_claim_slot()`
+ * @param pos  The position from `log_claim_slot()`
+ */
+static void log_publish_slot(LogSlot* slot, uint32_t pos) {
+
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+}
+
+
+/**
+ * @brief Add every published message in the queue to the batch, and post
+ *        the batch if it's due.
+ *        There is only ever one consumer: a caller that finds another
+ *        drain in progress returns at once.
+ *
+ * @param flush Post the batch whether or not it's due.
+ */
+static void log_drain(bool flush) {
+
+    if (atomic_flag_test_and_set_explicit(&log_drain_lock, memory_order_acquire)) return;
+
+    while (true) {
+        LogSlot* slot = &log_queue[log_dequeue_pos & (LOG_QUEUE_LENGTH - 1)];
+        uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if ((int32_t)(sequence - (log_dequeue_pos + 1)) < 0) break;
+
+        const char* text = slot->text;
+        uint16_t length = slot->length;
+#if !LOG_TOKENIZED
+        char formatted[LOG_MESSAGE_MAX_LEN_B];
+        if (slot->flags & LOG_FLAG_DEFERRED) {
+            length = log_format_deferred(slot, formatted);
+            text = formatted;
+        }
+#endif
+
+        log_output(text, length, slot->queued_tick, (slot->flags & LOG_FLAG_ERROR) != 0);
+
+        // Free the slot for the producer's next pass through the ring
+        atomic_store_explicit(&slot->sequence, log_dequeue_pos + LOG_QUEUE_LENGTH, memory_order_release);
+        log_dequeue_pos++;
+    }
+
+    // Report any messages lost since the last drain
+    TickType_t now = xTaskGetTickCount();
+    uint32_t dropped = atomic_exchange_explicit(&log_dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        char notice[48];
+        int length = snprintf(notice, sizeof(notice), "[ERROR] %lu log message(s) dropped", (unsigned long)dropped);
+        log_output(notice, (uint16_t)length, now, true);
+    }
+
+    if (LOG_LEVEL_ENABLED(LOG_MODULE, LOG_LEVEL_DEBUG) && now - log_batch_stats_tick >= pdMS_TO_TICKS(LOG_BATCH_STATS_INTERVAL_MS)) {
+        log_batch_stats_tick = now;
+        log_report_batch_stats();
+    }
+
+    if (flush) {
+        log_flush(&log_batch_stats.flushes_error);
+    } else if ((log_batch_count > 0 || log_repeat_count > 0) &&
+               now - log_batch_oldest_tick >= pdMS_TO_TICKS(LOG_BATCH_DEADLINE_MS)) {
+        log_flush(&log_batch_stats.flushes_deadline);
+    }
+
+    atomic_flag_clear_explicit(&log_drain_lock, memory_order_release);
+}
+
+
+/**
+ * @brief Output a message, collapsing a run of identical messages into
+ *        the first one and a count of the repeats.
+ *
+ * @param message     The message text
+ * @param length      The message length in bytes
+ * @param queued_tick When the message was queued
+ * @param is_err      Is the message an error?
+ */
+static void log_output(const char* message, uint16_t length, TickType_t queued_tick, bool is_err) {
+
+    if (length == log_last_length && memcmp(message, log_last, length) == 0 &&
+        queued_tick - log_last_tick < pdMS_TO_TICKS(LOG_REPEAT_WINDOW_MS)) {
+        // The pending count is due to be posted like a message
+        if (log_repeat_count == 0 && log_batch_count == 0) log_batch_oldest_tick = queued_tick;
+        log_repeat_count++;
+        log_last_tick = queued_tick;
+        return;
+    }
+
+    log_output_repeats();
+
+    if (length > sizeof(log_last)) length = sizeof(log_last);
+    memcpy(log_last, message, length);
+    log_last_length = length;
+    log_last_is_err = is_err;
+    log_last_tick = queued_tick;
+    log_append(message, length, queued_tick, is_err);
+}
+
+
+/**
+ * @brief Add the count of repeats of the last message, if any, to the batch.
+ */
+static void log_output_repeats(void) {
+
+    if (log_repeat_count == 0) return;
+
+    char notice[56];
+    int length = snprintf(notice, sizeof(notice), "%s Previous message repeated %lu time(s)",
+                          log_last_is_err ? "[ERROR]" : "[DEBUG]", (unsigned long)log_repeat_count);
+    log_repeat_count = 0;
+    log_append(notice, (uint16_t)length, log_last_tick, false);
+}
+
+
+/**
+ * @brief Add a message to the batch.
+ *        An error message is posted at once, with the rest of the batch.
+ *
+ * @param message     The message text
+ * @param length      The message length in bytes
+ * @param queued_tick When the message was queued
+ * @param is_err      Is the message an error?
+ */
+static void log_append(const char* message, uint16_t length, TickType_t queued_tick, bool is_err) {
+
+#if LOG_TOKENIZED
+    // Queued messages are binary frames: send them as '$' + Base64.
+    // Other text, such as the dropped-message notice, is sent as is
+    char frame[1 + 4 * ((LOG_MESSAGE_MAX_LEN_B + 2) / 3)];
+    if (message[0] != '[') {
+        frame[0] = '$';
+        length = 1 + log_base64((const uint8_t*)message, length, &frame[1]);
+        message = frame;
+    }
+#endif
+
+    // Post the batch first if the message, and a separator, won't fit
+    if (log_batch_count > 0 && log_batch_length + 1 + length > LOG_BATCH_MAX_B) {
+        log_flush(&log_batch_stats.flushes_full);
+    }
+
+    if (log_batch_count > 0) {
+        log_batch[log_batch_length++] = '\n';
+    } else {
+        log_batch_oldest_tick = queued_tick;
+    }
+
+    memcpy(&log_batch[log_batch_length], message, length);
+    log_batch_length += length;
+    log_batch_count++;
 
 #ifdef UART_LOGGING_H
     // Do we output via UART too?
-    if (uart_available) log_uart_output(buffer);
+    if (uart_available) log_uart_output((char*)message);
 #endif
+
+    if (is_err) log_flush(&log_batch_stats.flushes_error);
+}
+
+
+/**
+ * @brief Post the batch with a single system call, and record its statistics.
+ *
+ * @param reason_count The flush reason counter to bump.
+ */
+static void log_flush(uint32_t* reason_count) {
+
+    log_output_repeats();
+    if (log_batch_count == 0) return;
+
+    // Output the messages using the system call
+    mvServerLog((const uint8_t*)log_batch, log_batch_length);
+    boot_mark(BOOT_PHASE_FIRST_LOG);
+
+    const uint32_t latency_ms = (xTaskGetTickCount() - log_batch_oldest_tick) * portTICK_PERIOD_MS;
+    log_batch_stats.batches++;
+    log_batch_stats.messages += log_batch_count;
+    log_batch_stats.bytes += log_batch_length;
+    log_batch_stats.total_latency_ms += latency_ms;
+    if (log_batch_count > log_batch_stats.max_messages) log_batch_stats.max_messages = log_batch_count;
+    if (latency_ms > log_batch_stats.max_latency_ms) log_batch_stats.max_latency_ms = latency_ms;
+    (*reason_count)++;
+
+    log_batch_length = 0;
+    log_batch_count = 0;
+}
+
+
+/**
+ * @brief Add a summary of the batch statistics to the batch.
+ */
+static void log_report_batch_stats(void) {
+
+    const LogBatchStats* stats = &log_batch_stats;
+    if (stats->batches == 0) return;
+
+    char report[LOG_MESSAGE_MAX_LEN_B];
+    int length = snprintf(report, sizeof(report),
+                          "[DEBUG] Log batches: %lu, messages: %lu (max %lu/batch), latency: %lu ms mean, %lu ms max, flushes full/deadline/error: %lu/%lu/%lu",
+                          (unsigned long)stats->batches, (unsigned long)stats->messages, (unsigned long)stats->max_messages,
+                          (unsigned long)(stats->total_latency_ms / stats->batches), (unsigned long)stats->max_latency_ms,
+                          (unsigned long)stats->flushes_full, (unsigned long)stats->flushes_deadline, (unsigned long)stats->flushes_error);
+    if (length > (int)sizeof(report) - 1) length = sizeof(report) - 1;
+    log_output(report, (uint16_t)length, xTaskGetTickCount(), false);
+}
+
+
+/**
+ * @brief Work out how long the log task can wait for a message before
+ *        the batch is due to be posted.
+ *
+ * @returns The wait in ticks.
+ */
+static TickType_t log_batch_wait(void) {
+
+    if (log_batch_count == 0 && log_repeat_count == 0) return portMAX_DELAY;
+
+    const TickType_t age = xTaskGetTickCount() - log_batch_oldest_tick;
+    const TickType_t deadline = pdMS_TO_TICKS(LOG_BATCH_DEADLINE_MS);
+    return age >= deadline ? 0 : deadline - age;
+}
+
+
+/**
+ * @brief  Function implementing the log task.
+ *         Batches queued messages whenever a producer signals, and
+ *         posts the batch when it's due.
+ *
+ * @param  argument: Not used
+ */
+static void task_log(void* argument) {
+
+    while (true) {
+        // Block until a message is queued or the batch is due
+        ulTaskNotifyTake(pdTRUE, log_batch_wait());
+        log_drain(false);
+    }
+}
+
+
+/**
+ * @brief Get the number of messages dropped because the queue was full.
+ *
+ * @returns The total since boot.
+ */
+uint32_t log_get_dropped_count(void) {
+
+    return atomic_load_explicit(&log_dropped_total, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Get the number of messages held back by call site rate limits.
+ *
+ * @returns The total since boot.
+ */
+uint32_t log_get_suppressed_count(void) {
+
+    return atomic_load_explicit(&log_suppressed_total, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Get the log batching statistics.
+ *
+ * @param stats Where to write the statistics.
+ */
+void log_get_batch_stats(LogBatchStats* stats) {
+
+    if (stats != NULL) *stats = log_batch_stats;
 }
 
 
@@ -138,6 +1062,9 @@ void do_assert(bool condition, char* message) {
 
     if (!condition) {
         server_error(message);
+
+        // Post the message now: we may never get back to the log task
+        log_drain(true);
         assert(false);
     }
 }
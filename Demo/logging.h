@@ -20,23 +20,232 @@
 #define     USER_HANDLE_LOGGING_STARTED         0xFFFF
 #define     USER_HANDLE_LOGGING_OFF             0
 
-#define     LOG_MESSAGE_MAX_LEN_B               1024
+// The longest message, including its `[DEBUG] ` prefix: longer messages
+// are cut short. Each of the queue's slots holds one message
+#define     LOG_MESSAGE_MAX_LEN_B               160
 #define     LOG_BUFFER_SIZE_B                   5120
 
+// Number of messages the log queue holds (must be a power of two)
+#define     LOG_QUEUE_LENGTH                    16
+
+#define     LOG_TASK_STACK_SIZE                 512
+#define     LOG_TASK_PRIORITY                   tskIDLE_PRIORITY
+
+// The log task joins queued messages with newlines and posts them in a
+// single `mvServerLog()` call. A batch is posted when the next message
+// won't fit, when its oldest message reaches the deadline, or at once
+// when it takes an error message
+#define     LOG_BATCH_MAX_B                     512
+#define     LOG_BATCH_DEADLINE_MS               250
+#define     LOG_BATCH_STATS_INTERVAL_MS         60000
+
+// Rate limiting: each call site, keyed by its format string, has a token
+// bucket of LOG_RATE_BURST messages which refills at one message every
+// LOG_RATE_REFILL_MS. Messages over the limit are counted, not queued,
+// and the count is added to the call site's next message
+#define     LOG_RATE_TABLE_SIZE                 32
+#define     LOG_RATE_MAX_PROBES                 4
+#define     LOG_RATE_BURST                      3
+#define     LOG_RATE_REFILL_MS                  5000
+
+// Identical messages queued within this period of each other are
+// posted once, followed by a count of the repeats
+#define     LOG_REPEAT_WINDOW_MS                1000
+
 #define     NET_NC_BUFFER_SIZE_R                8
 
+// Tokenized logging: see `log_tokenized()` in `logging.c`
+#ifndef LOG_TOKENIZED
+#define     LOG_TOKENIZED                       0
+#endif
+
+#define     LOG_FLAG_ERROR                      0x01
+#define     LOG_FLAG_SUPPRESSED                 0x02
+#define     LOG_FLAG_UNLIMITED                  0x04
+#define     LOG_FLAG_DEFERRED                   0x08
+#define     LOG_FLAG_FROM_ISR                   0x80
+
+#define     LOG_ARG_INT                         1
+#define     LOG_ARG_LONG                        2
+#define     LOG_ARG_LLONG                       3
+#define     LOG_ARG_DOUBLE                      4
+#define     LOG_ARG_STRING                      5
+
+// A string argument is framed as a length byte, then up to
+// LOG_TOKEN_STRING_MAX_LEN_B characters: enough for the device ID.
+// The length byte's top bit marks a string which was cut short
+#define     LOG_TOKEN_STRING_MAX_LEN_B          48
+#define     LOG_TOKEN_STRING_TRUNCATED          0x80
+
+// Log levels: a module logs messages at or below its level
+#define     LOG_LEVEL_NONE                      0
+#define     LOG_LEVEL_ERROR                     1
+#define     LOG_LEVEL_DEBUG                     2
+
+// Modules with their own log level. Each source file sets `LOG_MODULE`
+// to its module before it includes `main.h`
+#define     LOG_MODULE_MAIN                     0
+#define     LOG_MODULE_I2C                      1
+#define     LOG_MODULE_MCP9808                  2
+#define     LOG_MODULE_LOGGING                  3
+#define     LOG_MODULE_COUNT                    4
+
+#ifndef LOG_MODULE
+#define     LOG_MODULE                          LOG_MODULE_MAIN
+#endif
+
+// Each module's compile-time log level, set in `CMakeLists.txt`.
+// Calls above the level are removed from the build
+#ifndef LOG_LEVEL_MAIN
+#define     LOG_LEVEL_MAIN                      LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_LEVEL_I2C
+#define     LOG_LEVEL_I2C                       LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_LEVEL_MCP9808
+#define     LOG_LEVEL_MCP9808                   LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_LEVEL_LOGGING
+#define     LOG_LEVEL_LOGGING                   LOG_LEVEL_DEBUG
+#endif
+
+// Set to 0 to drop the runtime level check -- see `log_set_level()`
+#ifndef LOG_RUNTIME_LEVELS
+#define     LOG_RUNTIME_LEVELS                  1
+#endif
+
+
+/*
+ * MACROS
+ */
+#define LOG_LEVEL_OF(module)                        ((module) == LOG_MODULE_I2C ? LOG_LEVEL_I2C :              \
+                                                     (module) == LOG_MODULE_MCP9808 ? LOG_LEVEL_MCP9808 :      \
+                                                     (module) == LOG_MODULE_LOGGING ? LOG_LEVEL_LOGGING :      \
+                                                     LOG_LEVEL_MAIN)
+
+#if LOG_RUNTIME_LEVELS
+#define LOG_LEVEL_ENABLED(module, level)            (LOG_LEVEL_OF(module) >= (level) && log_levels[(module)] >= (level))
+#else
+#define LOG_LEVEL_ENABLED(module, level)            (LOG_LEVEL_OF(module) >= (level))
+#endif
+
+/*
+ * A log call is checked against the calling module's level before its
+ * arguments are evaluated. When the compile-time level rules the call
+ * out, the condition is a constant and the compiler drops the call and
+ * its format string. The `if (0)` call is never made, but keeps the
+ * compiler's printf format checks, and the arguments in use, either way.
+ */
+#define LOG_AT_LEVEL(level, flags, format_string, ...)                                      \
+    do {                                                                                    \
+        if (0) log_format_check(format_string, ##__VA_ARGS__);                              \
+        if (LOG_LEVEL_ENABLED(LOG_MODULE, level)) {                                         \
+            LOG_POST((flags), (format_string), ##__VA_ARGS__);                              \
+        }                                                                                   \
+    } while (0)
+
+#define server_log(format_string, ...)              LOG_AT_LEVEL(LOG_LEVEL_DEBUG, 0, format_string, ##__VA_ARGS__)
+#define server_error(format_string, ...)            LOG_AT_LEVEL(LOG_LEVEL_ERROR, LOG_FLAG_ERROR, format_string, ##__VA_ARGS__)
+// For reports which log a bounded set of lines from one call site,
+// eg. one per sensor: these skip the call site's rate limit
+#define server_report(format_string, ...)           LOG_AT_LEVEL(LOG_LEVEL_DEBUG, LOG_FLAG_UNLIMITED, format_string, ##__VA_ARGS__)
+#define server_log_from_isr(format_string, ...)     LOG_AT_LEVEL(LOG_LEVEL_DEBUG, LOG_FLAG_FROM_ISR, format_string, ##__VA_ARGS__)
+#define server_error_from_isr(format_string, ...)   LOG_AT_LEVEL(LOG_LEVEL_ERROR, LOG_FLAG_ERROR | LOG_FLAG_FROM_ISR, format_string, ##__VA_ARGS__)
+
+/*
+ * Tokenized log calls, and text log calls from ISRs, pass the format
+ * string's address and a word which records the count (bits 0-3) and type
+ * (three bits each, from bit 4) of up to eight arguments, worked out at
+ * compile time.
+ */
+#define LOG_ARG_TYPE(arg) _Generic((arg),           \
+    float: LOG_ARG_DOUBLE,                          \
+    double: LOG_ARG_DOUBLE,                         \
+    char*: LOG_ARG_STRING,                          \
+    const char*: LOG_ARG_STRING,                    \
+    signed char*: LOG_ARG_STRING,                   \
+    unsigned char*: LOG_ARG_STRING,                 \
+    const unsigned char*: LOG_ARG_STRING,           \
+    long: LOG_ARG_LONG,                             \
+    unsigned long: LOG_ARG_LONG,                    \
+    long long: LOG_ARG_LLONG,                       \
+    unsigned long long: LOG_ARG_LLONG,              \
+    default: LOG_ARG_INT)
+
+#define LOG_ARG_COUNT(...)                          LOG_ARG_COUNT_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_ARG_COUNT_(_, a, b, c, d, e, f, g, h, count, ...)   count
+#define LOG_CONCAT(a, b)                            LOG_CONCAT_(a, b)
+#define LOG_CONCAT_(a, b)                           a##b
+#define LOG_ARG_TYPES(...)                          LOG_CONCAT(LOG_ARG_TYPES_, LOG_ARG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_ARG_AT(arg, index)                      ((uint32_t)LOG_ARG_TYPE(arg) << (4 + 3 * (index)))
+#define LOG_ARG_TYPES_0()                           0u
+#define LOG_ARG_TYPES_1(a)                          (1u | LOG_ARG_AT(a, 0))
+#define LOG_ARG_TYPES_2(a, b)                       (2u | LOG_ARG_AT(a, 0) | LOG_ARG_AT(b, 1))
+#define LOG_ARG_TYPES_3(a, b, c)                    (3u | LOG_ARG_AT(a, 0) | LOG_ARG_AT(b, 1) | LOG_ARG_AT(c, 2))
+#define LOG_ARG_TYPES_4(a, b, c, d)                 (4u | LOG_ARG_AT(a, 0) | LOG_ARG_AT(b, 1) | LOG_ARG_AT(c, 2) | LOG_ARG_AT(d, 3))
+#define LOG_ARG_TYPES_5(a, b, c, d, e)              ((LOG_ARG_TYPES_4(a, b, c, d) + 1u) | LOG_ARG_AT(e, 4))
+#define LOG_ARG_TYPES_6(a, b, c, d, e, f)           ((LOG_ARG_TYPES_5(a, b, c, d, e) + 1u) | LOG_ARG_AT(f, 5))
+#define LOG_ARG_TYPES_7(a, b, c, d, e, f, g)        ((LOG_ARG_TYPES_6(a, b, c, d, e, f) + 1u) | LOG_ARG_AT(g, 6))
+#define LOG_ARG_TYPES_8(a, b, c, d, e, f, g, h)     ((LOG_ARG_TYPES_7(a, b, c, d, e, f, g) + 1u) | LOG_ARG_AT(h, 7))
+
+#if LOG_TOKENIZED
+#define LOG_POST(flags, format_string, ...)         log_tokenized(flags, format_string, LOG_ARG_TYPES(__VA_ARGS__), ##__VA_ARGS__)
+#else
+// `flags` is a constant, so each call site keeps only one of the calls.
+// An ISR's message is formatted later, by the log task
+#define LOG_POST(flags, format_string, ...)                                                 \
+    (((flags) & LOG_FLAG_FROM_ISR)                                                          \
+        ? log_text_from_isr(flags, format_string, LOG_ARG_TYPES(__VA_ARGS__), ##__VA_ARGS__) \
+        : log_text(flags, format_string, ##__VA_ARGS__))
+#endif
+
+
+/*
+ * TYPES
+ */
+typedef struct {
+    uint32_t    batches;
+    uint32_t    messages;
+    uint32_t    bytes;
+    uint32_t    max_messages;
+    uint32_t    total_latency_ms;
+    uint32_t    max_latency_ms;
+    uint32_t    flushes_full;
+    uint32_t    flushes_deadline;
+    uint32_t    flushes_error;
+} LogBatchStats;
+
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+/*
+ * GLOBALS
+ */
+// Each module's runtime log level -- see `log_set_level()`
+extern uint8_t log_levels[LOG_MODULE_COUNT];
+
+
 /*
  * PROTOTYPES
  */
-void server_log(char* format_string, ...)        __attribute__ ((__format__ (__printf__, 1, 2)));
-void server_error(char* format_string, ...)      __attribute__ ((__format__ (__printf__, 1, 2)));
+#if LOG_TOKENIZED
+void log_tokenized(uint8_t flags, const char* format_string, uint32_t arg_types, ...);
+#else
+void log_text(uint8_t flags, const char* format_string, ...)  __attribute__ ((__format__ (__printf__, 2, 3)));
+void log_text_from_isr(uint8_t flags, const char* format_string, uint32_t arg_types, ...);
+#endif
+void log_format_check(const char* format_string, ...)  __attribute__ ((__format__ (__printf__, 1, 2)));
+void log_set_level(uint8_t module, uint8_t level);
+uint8_t log_get_level(uint8_t module);
 void do_assert(bool condition, char* message);
+BaseType_t log_create_task(void);
+uint32_t log_get_dropped_count(void);
+uint32_t log_get_suppressed_count(void);
+void log_get_batch_stats(LogBatchStats* stats);
+uint16_t log_base64(const uint8_t* data, uint16_t length, char* out);
 
 
 #ifdef __cplusplus
@@ -6,6 +6,7 @@
  * Licence: MIT
  *
  */
+#define LOG_MODULE LOG_MODULE_MAIN
 #include "main.h"
 #include "app_version.h"
 
@@ -17,9 +18,8 @@ static void         system_clock_config(void);
 static void         init_gpio(void);
 static void         task_led(void *argument);
 static void         task_sensor(void *argument);
-static void         task_alert(void* argument);
-static void         set_alert_timer(void);
-static void         timer_fired_callback(TimerHandle_t timer);
+static void         configure_sensor(MCP9808_Device* sensor);
+static void         run_alert_check(void);
 static void         log_device_info(void);
 
 
@@ -29,23 +29,19 @@ static void         log_device_info(void);
 // FreeRTOS Task handles
 TaskHandle_t handle_task_sensor = NULL;
 TaskHandle_t handle_task_led = NULL;
-TaskHandle_t handle_task_alert = NULL;
 
 // I2C-related values (defined in `i2c.c`)
 extern I2C_HandleTypeDef i2c;
 
 static bool    use_i2c = false;
-static bool    got_mcp9808 = false;
 
-/**
- *  Theses variables may be changed by interrupt handler code,
- *  so we mark them as `volatile` to ensure compiler optimization
- *  doesn't render them immutable at runtime
- */
-static volatile bool    alert_fired = false;
-static volatile double  current_temp = 0.0;
-// FreeRTOS Timers
-volatile TimerHandle_t alert_timer = NULL;
+#if configSUPPORT_STATIC_ALLOCATION == 1
+// Task storage, in place of the FreeRTOS heap
+static StackType_t      task_led_stack[TASK_LED_STACK_SIZE];
+static StaticTask_t     task_led_tcb;
+static StackType_t      task_sensor_stack[TASK_SENSOR_STACK_SIZE];
+static StaticTask_t     task_sensor_tcb;
+#endif
 
 
 /**
@@ -55,43 +51,47 @@ int main(void) {
 
     // Initialise the STM32U5 HAL
     HAL_Init();
+    boot_mark(BOOT_PHASE_HAL);
 
     // Configure the system clock
     system_clock_config();
+    timestamp_cycles_init();
+    boot_mark(BOOT_PHASE_CLOCK);
 
-    // Log the device ID and app details
-    log_device_info();
-
-    // Initialise hardware: the LED and alert pins,
-    // and the I2C bus to which the MCP9808 is connected.
+    // Initialise hardware: the LED and alert pins.
+    // Everything else waits for the scheduler, so it runs alongside the
+    // first ticks: the LED task logs the device details, and the sensor
+    // task brings up the I2C bus and looks for the sensors
     init_gpio();
-    use_i2c = I2C_init();
-    if (use_i2c) got_mcp9808 = MCP9808_init();
-
-    // Prep the MCP9808 temperature sensor (if present)
-    if (got_mcp9808) {
-        // Set the lower, upper and critical temperature values
-        MCP9808_set_lower_limit(TEMP_LOWER_LIMIT_C);
-        MCP9808_set_upper_limit(TEMP_UPPER_LIMIT_C);
-        MCP9808_set_critical_limit(TEMP_CRIT_LIMIT_C);
-        // And enable alerts (off by default)
-        MCP9808_clear_alert(true);
-
-        // Get a temperature reading
-        current_temp = MCP9808_read_temp();
-    } else {
-        server_error("MCP9808 not ready");
-    }
+    boot_mark(BOOT_PHASE_GPIO);
 
-    // Set up two FreeRTOS tasks
+    // Set up the FreeRTOS tasks
     // NOTE Argument #3 is the task stack size in words not bytes, ie. 512 -> 2048 bytes
-    //      Task stack sizes are allocated in the FreeRTOS heap, set in `FreeRTOSConfig.h`
-    BaseType_t status_task_led = xTaskCreate(task_led, "LED_TASK", 1024, NULL, 1, &handle_task_led);
-    BaseType_t status_task_sensor = xTaskCreate(task_sensor, "WORK_TASK", 2048, NULL, 1, &handle_task_sensor);
-    BaseType_t status_task_alert = xTaskCreate(task_alert, "ALERT_TASK", 1024, NULL, 0, &handle_task_alert);
-
-    if (status_task_led == pdPASS && status_task_sensor == pdPASS && status_task_alert == pdPASS) {
+    //      Task stacks are allocated in the FreeRTOS heap, set in `FreeRTOSConfig.h`,
+    //      or in the storage above if STATIC_ALLOCATION is set
+#if configSUPPORT_STATIC_ALLOCATION == 1
+    handle_task_led = xTaskCreateStatic(task_led, "LED_TASK", TASK_LED_STACK_SIZE, NULL, 1, task_led_stack, &task_led_tcb);
+    handle_task_sensor = xTaskCreateStatic(task_sensor, "WORK_TASK", TASK_SENSOR_STACK_SIZE, NULL, 1, task_sensor_stack, &task_sensor_tcb);
+    BaseType_t status_task_led = (handle_task_led != NULL) ? pdPASS : pdFAIL;
+    BaseType_t status_task_sensor = (handle_task_sensor != NULL) ? pdPASS : pdFAIL;
+#else
+    BaseType_t status_task_led = xTaskCreate(task_led, "LED_TASK", TASK_LED_STACK_SIZE, NULL, 1, &handle_task_led);
+    BaseType_t status_task_sensor = xTaskCreate(task_sensor, "WORK_TASK", TASK_SENSOR_STACK_SIZE, NULL, 1, &handle_task_sensor);
+#endif
+
+    // The alert state machine, and its timer. The sensor task reads the sensors for it
+    BaseType_t status_task_alert = alert_create_task(handle_task_sensor);
+
+    // Messages logged from here on are posted by the log task
+    BaseType_t status_task_log = log_create_task();
+
+    // I2C transactions from here on are run by the bus manager task
+    BaseType_t status_task_i2c = I2C_create_task();
+
+    if (status_task_led == pdPASS && status_task_sensor == pdPASS && status_task_alert == pdPASS &&
+        status_task_log == pdPASS && status_task_i2c == pdPASS) {
         // Start the scheduler
+        boot_mark(BOOT_PHASE_TASKS);
         vTaskStartScheduler();
     } else {
         // We should never get here as control is now taken by the scheduler
@@ -173,28 +173,77 @@ static void init_gpio(void) {
 
 /**
  * @brief  Function implementing the LED flasher task.
- *         Blinks the USER LED if there is no alert in progress.
+ *         Logs the device details and, once startup is complete, the
+ *         boot report. Blinks the USER LED if there is no alert in
+ *         progress, and periodically logs the tickless idle counters,
+ *         each task's share of the CPU, its stack use and the heap.
+ *         Logs the kernel trace once a trigger has frozen it.
  *
  * @param  argument: Not used
  */
 static void task_led(void *argument) {
 
-    // Get the pause period in ticks from a millisecond value
+    // Get the pause periods in ticks from millisecond values
     const TickType_t led_pause_ticks = pdMS_TO_TICKS(LED_FLASH_INTERVAL_MS);
+    const TickType_t led_no_sensor_ticks = pdMS_TO_TICKS(LED_NO_SENSOR_INTERVAL_MS);
+    TickType_t power_stats_tick = xTaskGetTickCount();
+    TickType_t cpu_stats_tick = xTaskGetTickCount();
+    TickType_t stack_stats_tick = xTaskGetTickCount();
+    TickType_t heap_stats_tick = xTaskGetTickCount();
+
+    // Log the device ID and app details
+    log_device_info();
+    boot_mark(BOOT_PHASE_DEVICE_INFO);
 
     while(1) {
         // Toggle the NDB's USER LED
-        if (!alert_fired) HAL_GPIO_TogglePin(LED_GPIO_PORT, LED_GPIO_PIN);
+        if (!alert_is_lit()) HAL_GPIO_TogglePin(LED_GPIO_PORT, LED_GPIO_PIN);
+
+        // Report the startup timeline, once it's complete
+        boot_report();
 
-        // Yield execution for a period
-        vTaskDelay(led_pause_ticks);
+        // Periodically report the time spent in tickless idle
+        if (xTaskGetTickCount() - power_stats_tick >= pdMS_TO_TICKS(POWER_STATS_INTERVAL_MS)) {
+            power_stats_tick = xTaskGetTickCount();
+            power_log_stats();
+        }
+
+        // Periodically report where the CPU time went
+        if (xTaskGetTickCount() - cpu_stats_tick >= pdMS_TO_TICKS(CPU_STATS_INTERVAL_MS)) {
+            cpu_stats_tick = xTaskGetTickCount();
+            cpu_log_stats();
+        }
+
+        // Periodically report how much of its stack each task has used
+        if (xTaskGetTickCount() - stack_stats_tick >= pdMS_TO_TICKS(STACK_STATS_INTERVAL_MS)) {
+            stack_stats_tick = xTaskGetTickCount();
+            stack_log_stats();
+        }
+
+        // Periodically report the heap, and what has allocated from it
+        if (xTaskGetTickCount() - heap_stats_tick >= pdMS_TO_TICKS(HEAP_STATS_INTERVAL_MS)) {
+            heap_stats_tick = xTaskGetTickCount();
+            heap_log_stats();
+        }
+
+        // Log the kernel trace, if it has been triggered
+        trace_dump();
+
+        // Yield execution for a period -- a shorter one, so the LED
+        // flashes quickly, while there's no sensor to read
+        vTaskDelay(MCP9808_get_device_count() > 0 ? led_pause_ticks : led_no_sensor_ticks);
     }
 }
 
 
 /**
  * @brief  Function implementing the MCP9808 temperature read task.
- *         Gets and logs the current temperature.
+ *         Initialises the I2C bus, then sweeps the sensors for their
+ *         current temperatures and adds each to the sample ring, which
+ *         reports it as part of a window.
+ *         Between sweeps, it looks for sensors which aren't online, and
+ *         configures each it finds, so sensors can be plugged in at any time,
+ *         and reads the sensors when the alert state machine asks it to.
  *
  * @param  argument: Not used
  */
@@ -203,78 +252,92 @@ static void task_sensor(void *argument) {
     // Get the pause period in ticks from a millisecond value
     const TickType_t ping_pause_ticks = pdMS_TO_TICKS(SENSOR_READ_INTERVAL_MS);
 
+    // Initialise the I2C bus to which the MCP9808s are connected
+    use_i2c = I2C_init();
+    boot_mark(BOOT_PHASE_I2C);
+
+    // Periodic readings and alert checks both come from this task
+    I2C_register_client(NULL, "SENSOR", I2C_PRIORITY_NORMAL);
+
+    TickType_t sweep_tick = xTaskGetTickCount();
     while(1) {
-        // Output the current reading
-        if (got_mcp9808) {
-            current_temp = MCP9808_read_temp();
+        // Look for sensors, if a search is due, and configure any found
+        const uint8_t found = use_i2c ? MCP9808_discover() : 0;
+        if (found != 0) {
+            boot_mark(BOOT_PHASE_SENSOR_FOUND);
+            for (uint8_t i = 0 ; i < MCP9808_MAX_DEVICES ; ++i) {
+                if (found & (1 << i)) configure_sensor(MCP9808_get_device(i));
+            }
+
+            boot_mark(BOOT_PHASE_SENSOR_CONFIGURED);
+
+            // Sweep as soon as the new sensors have converted at their
+            // resolution, rather than wait out the pause between sweeps
+            sweep_tick = MCP9808_next_sweep_tick(xTaskGetTickCount());
         }
 
-        server_log("Current temperature: %.2f°C", current_temp);
+        // Take the current reading from every sensor, if a sweep is due
+        if ((int32_t)(xTaskGetTickCount() - sweep_tick) >= 0) {
+            int16_t temps[MCP9808_MAX_DEVICES] = {0};
+            HAL_StatusTypeDef results[MCP9808_MAX_DEVICES];
+            const uint8_t swept = MCP9808_sweep(temps, results);
+
+            for (uint8_t i = 0 ; i < MCP9808_MAX_DEVICES ; ++i) {
+                if ((swept & (1 << i)) == 0) continue;
+                if (results[i] == HAL_OK) {
+                    // Keep the reading -- it's reported as part of a window
+                    samples_add(i, temps[i]);
+                    boot_mark(BOOT_PHASE_FIRST_SAMPLE);
+                } else {
+                    server_error("MCP9808 %u temperature read failed", i);
+                }
+            }
+
+            // Sweep again after a period -- or longer, if that's too soon
+            // for every sensor to have completed a conversion we haven't read
+            sweep_tick = MCP9808_next_sweep_tick(sweep_tick + ping_pause_ticks);
+        }
 
-        // Yield execution for a period
-        vTaskDelay(ping_pause_ticks);
+        // Yield execution until the next sweep, or search if that's sooner,
+        // unless the alert asks for a check first
+        const TickType_t wake_tick = MCP9808_next_discover_tick(sweep_tick);
+        const TickType_t now = xTaskGetTickCount();
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, (int32_t)(wake_tick - now) > 0 ? wake_tick - now : 0);
+        if (events & ALERT_NOTIFY_CHECK) run_alert_check();
     }
 }
 
 
 /**
- * @brief  Function implementing the alert watcher task.
+ * @brief  Configure a newly found sensor: set its limits and resolution,
+ *         and enable its alert.
  *
- * @param  argument: Not used
+ * @param  sensor: The sensor.
  */
-static void task_alert(void* argument) {
+static void configure_sensor(MCP9808_Device* sensor) {
 
-    while (1) {
-        // Block until a notification arrives
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-
-        // Show the IRQ was hit
-        HAL_GPIO_WritePin(LED_GPIO_PORT, LED_GPIO_PIN, GPIO_PIN_SET);
+    // Set the lower, upper and critical temperature values
+    MCP9808_set_lower_limit(sensor, TEMP_LOWER_LIMIT_C);
+    MCP9808_set_upper_limit(sensor, TEMP_UPPER_LIMIT_C);
+    MCP9808_set_critical_limit(sensor, TEMP_CRIT_LIMIT_C);
+    MCP9808_set_resolution(sensor, SENSOR_RESOLUTION);
 
-        // Set and start a timer to clear the alert
-        set_alert_timer();
-     }
+    // And enable alerts (off by default)
+    MCP9808_clear_alert(sensor, true);
 }
 
 
 /**
- * @brief Set and start a timer to clear the current alert.
- *        The function `timer_fired_callback()` is called when
- *        the timer fires.
+ * @brief  Read every sensor for the alert state machine, which
+ *         asks for a check while an alert is active or cooling.
  */
-static void set_alert_timer(void) {
-
-    // Set up and start a FreeRTOS timer
-    alert_timer = xTimerCreate("ALERT_TIMER",
-                               pdMS_TO_TICKS(ALERT_DISPLAY_PERIOD_MS),
-                               pdFALSE,
-                               (void*)0,
-                               timer_fired_callback);
-    if (alert_timer != NULL) xTimerStart(alert_timer, SENSOR_TASK_WAIT_TICKS);
-}
-
+static void run_alert_check(void) {
 
-/**
- * @brief Callback actioned when the post IRQ timer fires.
- *
- * @param timer: The triggering timer.
- */
-static void timer_fired_callback(TimerHandle_t timer) {
-
-    // Check whether the alert condition has passed
-    // NOTE The MCP980 does not signal this on the ALERT pin
-    current_temp = MCP9808_read_temp();
-    if (current_temp < (double)TEMP_UPPER_LIMIT_C) {
-        // Clear the LED and the alert
-        HAL_GPIO_WritePin(LED_GPIO_PORT, LED_GPIO_PIN, GPIO_PIN_RESET);
-        alert_fired = false;
-
-        // Clear the timer
-        alert_timer = NULL;
-    } else {
-        // Temperature still too high -- restart the timer
-        set_alert_timer();
-    }
+    int16_t temps[MCP9808_MAX_DEVICES] = {0};
+    HAL_StatusTypeDef results[MCP9808_MAX_DEVICES];
+    const uint8_t swept = MCP9808_sweep(temps, results);
+    alert_check(temps, results, swept);
 }
 
 
@@ -283,7 +346,9 @@ static void timer_fired_callback(TimerHandle_t timer) {
  */
 void EXTI11_IRQHandler(void) {
 
+    TRACE_ISR_ENTER(EXTI11_IRQn);
     HAL_GPIO_EXTI_IRQHandler(MCP_INT_PIN);
+    TRACE_ISR_EXIT(EXTI11_IRQn);
 }
 
 
@@ -294,10 +359,7 @@ void EXTI11_IRQHandler(void) {
  */
 void HAL_GPIO_EXTI_Falling_Callback(uint16_t pin) {
 
-    // Make sure the LED flasher task doesn't flash the LED
-    alert_fired = true;
-
-    // Signal the alert clearance task
+    // Signal the alert task
     // IMPORTANT Calling FreeRTOS functions from ISRs requires
     //           close attention. Use `...FromISR()` versions of
     //           calls, and ensure the IRQs which trigger this
@@ -305,7 +367,10 @@ void HAL_GPIO_EXTI_Falling_Callback(uint16_t pin) {
     //           https://www.freertos.org/RTOS-Cortex-M3-M4.html
     //           and `init_gpio()a, above.
     BaseType_t higher_priority_task_woken = pdFALSE;
-    vTaskNotifyGiveFromISR(handle_task_alert, &higher_priority_task_woken);
+    alert_raise_from_isr(&higher_priority_task_woken);
+
+    // Logging from an ISR is safe: the message is queued for the log task
+    server_log_from_isr("MCP9808 alert on pin 0x%04x", pin);
     portYIELD_FROM_ISR(higher_priority_task_woken);
 }
 
@@ -323,3 +388,43 @@ static void log_device_info(void) {
 }
 
 
+#if configSUPPORT_STATIC_ALLOCATION == 1
+/**
+ * @brief Provide the idle task's stack and control block, as FreeRTOS
+ *        requires when static allocation is enabled.
+ *
+ * @param tcb_buffer:   Where to write the address of the control block.
+ * @param stack_buffer: Where to write the address of the stack.
+ * @param stack_size:   Where to write the stack size, in words.
+ */
+void vApplicationGetIdleTaskMemory(StaticTask_t** tcb_buffer, StackType_t** stack_buffer, uint32_t* stack_size) {
+
+    static StaticTask_t idle_task_tcb;
+    static StackType_t idle_task_stack[configMINIMAL_STACK_SIZE];
+
+    *tcb_buffer = &idle_task_tcb;
+    *stack_buffer = idle_task_stack;
+    *stack_size = configMINIMAL_STACK_SIZE;
+}
+
+
+/**
+ * @brief Provide the timer service task's stack and control block, as
+ *        FreeRTOS requires when static allocation is enabled.
+ *
+ * @param tcb_buffer:   Where to write the address of the control block.
+ * @param stack_buffer: Where to write the address of the stack.
+ * @param stack_size:   Where to write the stack size, in words.
+ */
+void vApplicationGetTimerTaskMemory(StaticTask_t** tcb_buffer, StackType_t** stack_buffer, uint32_t* stack_size) {
+
+    static StaticTask_t timer_task_tcb;
+    static StackType_t timer_task_stack[configTIMER_TASK_STACK_DEPTH];
+
+    *tcb_buffer = &timer_task_tcb;
+    *stack_buffer = timer_task_stack;
+    *stack_size = configTIMER_TASK_STACK_DEPTH;
+}
+#endif
+
+
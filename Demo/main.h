@@ -36,6 +36,16 @@
 #include "i2c.h"
 #include "mcp9808.h"
 #include "logging.h"
+#include "timestamp.h"
+#include "samples.h"
+#include "power.h"
+#include "boot.h"
+#include "alert.h"
+#include "cpu.h"
+#include "stack.h"
+#include "heap.h"
+#include "trace.h"
+#include "latency.h"
 
 
 /*
@@ -43,10 +53,19 @@
  */
 #define     SENSOR_READ_INTERVAL_MS     10000
 #define     LED_FLASH_INTERVAL_MS       250
+#define     LED_NO_SENSOR_INTERVAL_MS   100
 #define     ALERT_DISPLAY_PERIOD_MS     20000
 
+// The sensor's resolution: finer resolutions take longer to convert,
+// so fresh readings are available less often
+#define     SENSOR_RESOLUTION           MCP9808_RESOLUTION_0_25C
+
 #define     SENSOR_TASK_WAIT_TICKS     20
 
+// Task stack sizes, in words
+#define     TASK_LED_STACK_SIZE         1024
+#define     TASK_SENSOR_STACK_SIZE      2048
+
 #define     LED_GPIO_PORT               GPIOA
 #define     LED_GPIO_PIN                GPIO_PIN_5
 
@@ -71,8 +90,6 @@ extern "C" {
 /*
  * PROTOTYPES
  */
-void server_log(char* format_string, ...);
-void server_error(char* format_string, ...);
 // Interrupt for alert pin
 void EXTI11_IRQHandler(void);
 
@@ -6,55 +6,167 @@
  * Licence: MIT
  *
  */
+#define LOG_MODULE LOG_MODULE_MCP9808
 #include "main.h"
 
 /*
  * STATIC PROTOTYPES
  */
-static void     MCP9808_set_temp_limit(uint8_t temp_register, uint16_t temp);
-static double   MCP9808_get_temp(uint8_t* data);
+static void     MCP9808_set_temp_limit(MCP9808_Device* device, uint8_t temp_register, uint16_t temp);
+static int16_t  MCP9808_get_temp(uint16_t temp_raw);
+static HAL_StatusTypeDef MCP9808_read_register(MCP9808_Device* device, uint8_t reg, uint16_t* value);
+static uint16_t MCP9808_register_length(uint8_t reg);
+static int8_t   MCP9808_shadow_index(uint8_t reg);
+static HAL_StatusTypeDef MCP9808_get_register(MCP9808_Device* device, uint8_t reg, uint16_t* value);
+static void     MCP9808_set_register(MCP9808_Device* device, uint8_t reg, uint16_t value);
+static HAL_StatusTypeDef MCP9808_flush(MCP9808_Device* device, bool verify);
+static uint32_t MCP9808_conversion_ms(uint16_t resolution);
 
 
 /*
  * GLOBALS
  */
-// I2C-related values (defined in `i2c.c`)
-extern I2C_HandleTypeDef i2c;
+// Sensors by address slot: slot n is the sensor at MCP9808_ADDR + n
+static MCP9808_Device   devices[MCP9808_MAX_DEVICES];
 
-uint16_t    limit_critical = DEFAULT_TEMP_LOWER_LIMIT_C;
-uint16_t    limit_lower = DEFAULT_TEMP_UPPER_LIMIT_C;;
-uint16_t    limit_upper = DEFAULT_TEMP_CRIT_LIMIT_C;
+// Discovery schedule: the next round is due at `discover_tick` if
+// `discover_pending` is set, ie. while any slot is offline
+static bool             discover_pending = true;
+static TickType_t       discover_tick = 0;
+static uint32_t         discover_backoff_ms = MCP9808_DISCOVER_MIN_MS;
+
+static const uint8_t    shadow_regs[MCP9808_SHADOW_COUNT] = {
+    MCP9808_REG_CONFIG,
+    MCP9808_REG_UPPER_TEMP,
+    MCP9808_REG_LOWER_TEMP,
+    MCP9808_REG_CRIT_TEMP,
+    MCP9808_REG_RESOLUTION
+};
+
+// Typical conversion times at each resolution
+static const uint16_t   conversion_ms[4] = { 30, 65, 130, 250 };
+static const char*      resolution_names[4] = { "0.5", "0.25", "0.125", "0.0625" };
+
+
+/**
+ *  @brief  Run a discovery round, if one is due: probe each of the
+ *          MCP9808's addresses with no sensor online, and bring online
+ *          each sensor which answers with the right IDs.
+ *
+ *          Rounds repeat while any address has no sensor, each pause
+ *          twice the last, up to MCP9808_DISCOVER_MAX_MS. A sensor which
+ *          goes offline restarts them at MCP9808_DISCOVER_MIN_MS, so it's
+ *          picked up again soon after it's plugged back in. Probes run
+ *          through the bus manager, so other tasks run during a round.
+ *
+ *  @returns A bit for each sensor brought online, by slot. The caller
+ *           configures these sensors: they start in their power-up state.
+ */
+uint8_t MCP9808_discover(void) {
+
+    if (!discover_pending || (int32_t)(xTaskGetTickCount() - discover_tick) < 0) return 0;
+
+    uint8_t found = 0;
+    for (uint8_t i = 0 ; i < MCP9808_ADDR_COUNT ; ++i) {
+        if (devices[i].online) continue;
+
+        const uint8_t address = MCP9808_ADDR + i;
+        if (!I2C_probe(address)) continue;
+        if (MCP9808_init(&devices[i], address)) {
+            devices[i].online = true;
+            found |= (1 << i);
+            server_report("MCP9808 found at 0x%02x", address);
+        }
+    }
+
+    // Schedule the next round, if any address still has no sensor
+    const uint8_t count = MCP9808_get_device_count();
+    discover_pending = (count < MCP9808_ADDR_COUNT);
+    discover_tick = xTaskGetTickCount() + pdMS_TO_TICKS(discover_backoff_ms);
+    if (count == 0) server_error("No MCP9808 found: next search in %lums", (unsigned long)discover_backoff_ms);
+
+    discover_backoff_ms *= 2;
+    if (discover_backoff_ms > MCP9808_DISCOVER_MAX_MS) discover_backoff_ms = MCP9808_DISCOVER_MAX_MS;
+    return found;
+}
+
+
+/**
+ *  @brief  Schedule a wake-up for the next discovery round.
+ *
+ *  @param  latest_tick: The tick the caller would otherwise wake at.
+ *
+ *  @returns `latest_tick`, or the tick the next discovery round is due,
+ *           whichever is earlier.
+ */
+TickType_t MCP9808_next_discover_tick(TickType_t latest_tick) {
+
+    if (discover_pending && (int32_t)(discover_tick - latest_tick) < 0) return discover_tick;
+    return latest_tick;
+}
+
+
+/**
+ *  @brief  Get the number of sensors online.
+ *
+ *  @returns The sensor count.
+ */
+uint8_t MCP9808_get_device_count(void) {
+
+    uint8_t count = 0;
+    for (uint8_t i = 0 ; i < MCP9808_MAX_DEVICES ; ++i) {
+        if (devices[i].online) count++;
+    }
+
+    return count;
+}
+
+
+/**
+ *  @brief  Get an online sensor.
+ *
+ *  @param  slot: The sensor's slot: its address less MCP9808_ADDR.
+ *
+ *  @returns The sensor, or `NULL` if there is no sensor online in that slot.
+ */
+MCP9808_Device* MCP9808_get_device(uint8_t slot) {
+
+    return (slot < MCP9808_MAX_DEVICES && devices[slot].online) ? &devices[slot] : NULL;
+}
 
 
 /**
- *  @brief  Check the device is connected and operational.
+ *  @brief  Set up a device at an address, and check the sensor there
+ *          is connected and operational.
+ *
+ *  @param  device:  The device to set up.
+ *  @param  address: The sensor's 7-bit I2C address.
  *
  *  @returns `true` if we can read values and they are right,
  *           otherwise `false`.
  */
-bool MCP9808_init(void) {
-
-    // Prep data storage buffers
-    uint8_t mid_data[2] = {0};
-    uint8_t did_data[2] = {0};
+bool MCP9808_init(MCP9808_Device* device, uint8_t address) {
 
-    // Read bytes from the sensor: MID...
-    uint8_t cmd = MCP9808_REG_MANUF_ID;
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, &cmd,     1, 100);
-    HAL_I2C_Master_Receive(&i2c,  MCP9808_ADDR << 1, mid_data, 2, 100);
+    *device = (MCP9808_Device){
+        .address = address,
+        .limit_lower = DEFAULT_TEMP_LOWER_LIMIT_C,
+        .limit_upper = DEFAULT_TEMP_UPPER_LIMIT_C,
+        .limit_critical = DEFAULT_TEMP_CRIT_LIMIT_C
+    };
 
-    // ...DID
-    cmd = MCP9808_REG_DEVICE_ID;
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, &cmd,     1, 100);
-    HAL_I2C_Master_Receive(&i2c,  MCP9808_ADDR << 1, did_data, 2, 100);
+    // Don't trust any register values from before
+    MCP9808_invalidate_cache(device);
 
-    // Bytes to integers
-    const uint16_t mid_value = (mid_data[0] << 8) | mid_data[1];
-    const uint16_t did_value = (did_data[0] << 8) | did_data[1];
+    // Read the MID and DID in one burst
+    const uint8_t regs[2] = { MCP9808_REG_MANUF_ID, MCP9808_REG_DEVICE_ID };
+    uint16_t values[2] = {0};
+    MCP9808_read_registers(device, regs, values, 2);
+    const uint16_t mid_value = values[0];
+    const uint16_t did_value = values[1];
 
     // Return false on data error
     if (mid_value != 0x0054 || did_value != 0x0400) {
-        server_error("MCP9808 reported Manufacturer ID: 0x%04x, Device ID: 0x%04x", mid_value, did_value);
+        server_error("MCP9808 at 0x%02x reported Manufacturer ID: 0x%04x, Device ID: 0x%04x", address, mid_value, did_value);
         return false;
     }
 
@@ -63,59 +175,219 @@ bool MCP9808_init(void) {
 
 
 /**
- *  @brief  Check the device is connected and operational.
+ *  @brief  Read the ambient temperature.
  *
- *  @returns `true` if the sensor is correct, otherwise `false`.
+ *  @param  device: The sensor.
+ *  @param  temp:   Where to write the temperature, in 1/16°C.
+ *                  It's left unchanged if the read fails.
+ *
+ *  @returns The HAL status of the read.
  */
-double MCP9808_read_temp(void) {
+HAL_StatusTypeDef MCP9808_read_temp(MCP9808_Device* device, int16_t* temp) {
 
-    // Read sensor and return its value in degrees celsius.
-    uint8_t temp_data[2] = { 0x06, 0x30 };
-    uint8_t cmd = MCP9808_REG_AMBIENT_TEMP;
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, &cmd, 1, 100);
-    HAL_StatusTypeDef result = HAL_I2C_Master_Receive(&i2c, MCP9808_ADDR << 1, temp_data, 2, 200);
+    uint16_t temp_raw = 0;
+    HAL_StatusTypeDef result = MCP9808_read_register(device, MCP9808_REG_AMBIENT_TEMP, &temp_raw);
+    if (result != HAL_OK) return result;
 
-    // Check for a read error -- if there is one, return its code
-    const uint32_t temp_raw = (temp_data[0] << 8) | temp_data[1];
-    if (temp_raw == 0x630) return (double)result;
+    // Convert to a signed value
+    *temp = MCP9808_get_temp(temp_raw);
 
-    // Scale and convert to signed value.
-    return MCP9808_get_temp(temp_data);
+    // The next conversion is certain to be ready one conversion time from now
+    device->fresh_tick = xTaskGetTickCount() + pdMS_TO_TICKS(MCP9808_get_conversion_ms(device));
+    device->fresh_tick_valid = true;
+    return HAL_OK;
 }
 
 
 /**
- * @brief Clear the sensor's alert flag, CONFIG bit 5.
- *        Optionally, enable the alert first.
+ *  @brief  Read every online sensor's temperature. Each read is a transaction
+ *          of its own, so the bus manager can run other clients' transactions
+ *          between them, and the sweep takes time in proportion to the
+ *          number of sensors. A sensor whose reads fail MCP9808_OFFLINE_FAILURES
+ *          times in a row is taken offline, and discovery looks for it again.
  *
- * @param do_enable: Set to `true` to enable the alert.
+ *  @param  temps:   Where to write the temperatures, in 1/16°C, by slot.
+ *                   A sensor's entry is left unchanged if its read fails.
+ *  @param  results: Where to write the HAL status of each read, by slot.
+ *
+ *  @returns A bit for each sensor read, by slot: only these entries are set.
  */
-void MCP9808_clear_alert(bool do_enable) {
+uint8_t MCP9808_sweep(int16_t* temps, HAL_StatusTypeDef* results) {
+
+    uint8_t swept = 0;
+    for (uint8_t i = 0 ; i < MCP9808_MAX_DEVICES ; ++i) {
+        MCP9808_Device* device = &devices[i];
+        if (!device->online) continue;
+
+        swept |= (1 << i);
+        results[i] = MCP9808_read_temp(device, &temps[i]);
+        if (results[i] == HAL_OK) {
+            device->failures = 0;
+        } else if (++device->failures >= MCP9808_OFFLINE_FAILURES) {
+            device->online = false;
+            server_error("MCP9808 at 0x%02x offline", device->address);
+
+            // Look for it again soon
+            discover_backoff_ms = MCP9808_DISCOVER_MIN_MS;
+            discover_tick = xTaskGetTickCount() + pdMS_TO_TICKS(discover_backoff_ms);
+            discover_pending = true;
+        }
+    }
 
-    // Read the current reg value
-    uint8_t config_data[3] = { MCP9808_REG_CONFIG, 0, 0 };
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, config_data, 1, 100);
-    HAL_I2C_Master_Receive(&i2c, MCP9808_ADDR << 1, &config_data[1], 2, 200);
+    return swept;
+}
 
-    // Clear the alert (clear bit 5)
-    config_data[2] &= MCP9808_CONFIG_CLEAR_ALERT;
 
-    // Enable/disable the alert (bit 4)
-    if (do_enable) {
-        config_data[2] |= MCP9808_CONFIG_ENABLE_ALERT;
+/**
+ * @brief Schedule a sweep so it gets a conversion from every sensor which
+ *        hasn't been read yet -- see `MCP9808_next_read_tick()`.
+ *
+ * @param earliest_tick: The earliest tick the caller wants to sweep at.
+ *
+ * @returns `earliest_tick`, or the tick at which every sensor is certain
+ *          to have a fresh conversion ready, whichever is later.
+ */
+TickType_t MCP9808_next_sweep_tick(TickType_t earliest_tick) {
+
+    TickType_t sweep_tick = earliest_tick;
+    for (uint8_t i = 0 ; i < MCP9808_MAX_DEVICES ; ++i) {
+        if (devices[i].online) sweep_tick = MCP9808_next_read_tick(&devices[i], sweep_tick);
     }
 
-    // Write config data back with changes
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, config_data, 3, 100);
+    return sweep_tick;
+}
+
+
+/**
+ * @brief Set the sensor's resolution, and so its conversion time.
+ *        Does nothing if the resolution is unchanged.
+ *
+ * @param device:     The sensor.
+ * @param resolution: The resolution, eg. `MCP9808_RESOLUTION_0_25C`.
+ *
+ * @returns `true` if the resolution was set, otherwise `false`.
+ */
+bool MCP9808_set_resolution(MCP9808_Device* device, uint8_t resolution) {
+
+    if (resolution > MCP9808_RESOLUTION_0_0625C) return false;
+
+    uint16_t current = MCP9808_RESOLUTION_DEFAULT;
+    if (MCP9808_get_register(device, MCP9808_REG_RESOLUTION, &current) != HAL_OK) return false;
+    if (current == resolution) return true;
+
+    MCP9808_set_register(device, MCP9808_REG_RESOLUTION, resolution);
+    if (MCP9808_flush(device, true) != HAL_OK) return false;
+
+    // The conversion under way completes at the old resolution,
+    // so the first at the new one is ready after both
+    device->fresh_tick = xTaskGetTickCount() + pdMS_TO_TICKS(MCP9808_conversion_ms(current) + MCP9808_conversion_ms(resolution));
+    device->fresh_tick_valid = true;
+
+    server_report("MCP9808 0x%02x Resolution Set: %s°C (%lums conversions)", device->address,
+                  resolution_names[resolution], (unsigned long)MCP9808_conversion_ms(resolution));
+    return true;
+}
+
+
+/**
+ * @brief Get the conversion time at the sensor's current resolution.
+ *
+ * @param device: The sensor.
+ *
+ * @returns The conversion time in milliseconds.
+ */
+uint32_t MCP9808_get_conversion_ms(MCP9808_Device* device) {
+
+    uint16_t resolution = MCP9808_RESOLUTION_DEFAULT;
+    MCP9808_get_register(device, MCP9808_REG_RESOLUTION, &resolution);
+    return MCP9808_conversion_ms(resolution);
+}
+
+
+/**
+ * @brief Schedule a temperature read so it gets a conversion which hasn't
+ *        been read yet, without waiting longer than that needs.
+ *
+ * @param device:        The sensor.
+ * @param earliest_tick: The earliest tick the caller wants to read at.
+ *
+ * @returns `earliest_tick`, or the tick at which a fresh conversion is
+ *          certain to be ready, whichever is later.
+ */
+TickType_t MCP9808_next_read_tick(MCP9808_Device* device, TickType_t earliest_tick) {
+
+    if (device->fresh_tick_valid && (int32_t)(device->fresh_tick - earliest_tick) > 0) return device->fresh_tick;
+    return earliest_tick;
+}
+
+
+/**
+ * @brief Format a temperature to two decimal places, eg. "-3.31",
+ *        without floating-point formatting.
+ *
+ * @param temp: The temperature in 1/16°C.
+ * @param text: Where to write the text: at least MCP9808_TEMP_TEXT_LEN bytes.
+ *
+ * @returns `text`, so the call can be a log argument.
+ */
+char* MCP9808_format_temp(int16_t temp, char* text) {
+
+    // Round to the nearest hundredth
+    const uint32_t magnitude = (uint32_t)(temp < 0 ? -temp : temp);
+    const uint32_t hundredths = (magnitude * 100 + MCP9808_TEMP_SCALE / 2) / MCP9808_TEMP_SCALE;
+
+    char digits[4];
+    uint8_t digit_count = 0;
+    uint32_t whole = hundredths / 100;
+    do {
+        digits[digit_count++] = (char)('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0 && digit_count < sizeof(digits));
+
+    char* cursor = text;
+    if (temp < 0) *cursor++ = '-';
+    while (digit_count > 0) *cursor++ = digits[--digit_count];
+    *cursor++ = '.';
+    *cursor++ = (char)('0' + (hundredths % 100) / 10);
+    *cursor++ = (char)('0' + hundredths % 10);
+    *cursor = '\0';
+    return text;
+}
+
+
+/**
+ * @brief Clear the sensor's alert by writing 1 to CONFIG bit 5.
+ *        Optionally, enable the alert first.
+ *
+ *        Bit 5 is write-1-to-clear and always reads back as zero, so it
+ *        isn't kept in the shadow: the clear is written directly, every
+ *        time, with the rest of CONFIG as the shadow holds it.
+ *
+ * @param device:    The sensor.
+ * @param do_enable: Set to `true` to enable the alert.
+ */
+void MCP9808_clear_alert(MCP9808_Device* device, bool do_enable) {
+
+    // Get the current reg value -- from the shadow, if it's valid
+    uint16_t config = 0;
+    if (MCP9808_get_register(device, MCP9808_REG_CONFIG, &config) != HAL_OK) {
+        server_error("MCP9808 0x%02x config read failed", device->address);
+        return;
+    }
 
-    // Read it back to apply?
-    uint8_t check_data[2] = {0};
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, config_data, 1, 100);
-    HAL_I2C_Master_Receive(&i2c, MCP9808_ADDR << 1, check_data, 2, 200);
+    // Enable the alert (bit 3), writing config data back if it has
+    // changed, and reading it back to check it
+    if (do_enable) {
+        config |= MCP9808_CONFIG_ENABLE_ALERT;
+        MCP9808_set_register(device, MCP9808_REG_CONFIG, config);
+        MCP9808_flush(device, true);
+    }
 
-    // Check the two values: READ LSB == WRITE & 0xDF
-    if (((config_data[2] & 0x0F) != check_data[1]) && do_enable) {
-        server_error("MCP9809 alert config mismatch. SET: %02x READ: %02x\n",  config_data[2],  check_data[1]);
+    // Clear the alert (set bit 5), bypassing the shadow
+    config |= MCP9808_CONFIG_CLEAR_ALERT;
+    uint8_t data[2] = { (uint8_t)(config >> 8), (uint8_t)(config & 0xFF) };
+    if (I2C_write_register(device->address, MCP9808_REG_CONFIG, data, sizeof(data), 200) != HAL_OK) {
+        server_error("MCP9808 0x%02x alert clear failed", device->address);
     }
 }
 
@@ -123,86 +395,333 @@ void MCP9808_clear_alert(bool do_enable) {
 /**
  * @brief Set the sensor upper threshold temperature.
  *
+ * @param device:     The sensor.
  * @param upper_temp: The target temperature.
  */
-void MCP9808_set_upper_limit(uint16_t upper_temp) {
+void MCP9808_set_upper_limit(MCP9808_Device* device, uint16_t upper_temp) {
 
-    limit_upper = upper_temp;
-    MCP9808_set_temp_limit(MCP9808_REG_UPPER_TEMP, upper_temp);
-    server_log("MCP9808 Hi Temp Set: %02i°C", upper_temp);
+    device->limit_upper = upper_temp;
+    MCP9808_set_temp_limit(device, MCP9808_REG_UPPER_TEMP, upper_temp);
+    server_report("MCP9808 0x%02x Hi Temp Set: %02i°C", device->address, upper_temp);
 }
 
 
 /**
  * @brief Set the sensor critical threshold temperature.
  *
+ * @param device:        The sensor.
  * @param critical_temp: The target temperature.
  */
-void MCP9808_set_critical_limit(uint16_t critical_temp) {
+void MCP9808_set_critical_limit(MCP9808_Device* device, uint16_t critical_temp) {
 
-    limit_critical = critical_temp;
-    MCP9808_set_temp_limit(MCP9808_REG_CRIT_TEMP, critical_temp);
-    server_log("MCP9808 Crit Temp Set: %02i°C", critical_temp);
+    device->limit_critical = critical_temp;
+    MCP9808_set_temp_limit(device, MCP9808_REG_CRIT_TEMP, critical_temp);
+    server_report("MCP9808 0x%02x Crit Temp Set: %02i°C", device->address, critical_temp);
 }
 
 
 /**
  * @brief Set the sensor lower threshold temperature.
  *
+ * @param device:     The sensor.
  * @param lower_temp: The target temperature.
  */
-void MCP9808_set_lower_limit(uint16_t lower_temp) {
+void MCP9808_set_lower_limit(MCP9808_Device* device, uint16_t lower_temp) {
 
-    limit_lower = lower_temp;
-    MCP9808_set_temp_limit(MCP9808_REG_LOWER_TEMP, lower_temp);
-    server_log("MCP9808 Lo Temp Set: %02i°C", lower_temp);
+    device->limit_lower = lower_temp;
+    MCP9808_set_temp_limit(device, MCP9808_REG_LOWER_TEMP, lower_temp);
+    server_report("MCP9808 0x%02x Lo Temp Set: %02i°C", device->address, lower_temp);
 }
 
 
 /**
  * @brief Set a sensor threshold temperature.
  *
+ * @param device:        The sensor.
  * @param temp_register: The target register:
  *                       MCP9808_REG_LOWER_TEMP
  *                       MCP9808_REG_UPPER_TEMP
  *                       MCP9808_REG_CRIT_TEMP.
  * @param temp:          The temperature (as an integer)
  */
-static void MCP9808_set_temp_limit(uint8_t temp_register, uint16_t temp) {
+static void MCP9808_set_temp_limit(MCP9808_Device* device, uint8_t temp_register, uint16_t temp) {
 
     temp &= 127;
-    temp = (temp << 4);
-    uint8_t data[3] = {temp_register};
-    data[1] = (temp & 0xFF00) >> 8;
-    data[2] = temp & 0xFF;
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, data, 3, 200);
+    MCP9808_set_register(device, temp_register, temp << 4);
+    MCP9808_flush(device, false);
 }
 
 
 /**
  * @brief Calculate the temperature.
  *
- * @returns The temperature in Celsius.
+ * @param temp_raw: The ambient temperature register value.
+ *
+ * @returns The temperature in 1/16°C.
  */
-static double MCP9808_get_temp(uint8_t* data) {
+static int16_t MCP9808_get_temp(uint16_t temp_raw) {
 
-    const uint32_t temp_raw = (data[0] << 8) | data[1];
-    double temp_cel = (temp_raw & 0x0FFF) / 16.0;
-    if (temp_raw & 0x1000) temp_cel = 256.0 - temp_cel;
-    return temp_cel;
+    // Bits 0-11 hold the magnitude, bit 12 the sign: 13-bit two's complement
+    int16_t temp = (int16_t)(temp_raw & 0x0FFF);
+    if (temp_raw & 0x1000) temp -= 4096;
+    return temp;
 }
 
 
 /**
  * @brief ALert state checker, used for debugging.
  *
+ * @param device: The sensor.
+ *
  * @returns `true` if the config register indicates an alert has been triggered,
  *          otherwise `false`.
  */
-bool MCP9808_get_alert_state(void) {
+bool MCP9808_get_alert_state(MCP9808_Device* device) {
+
+    // The alert status bit is live, so bypass the shadow
+    uint16_t config = 0;
+    MCP9808_read_register(device, MCP9808_REG_CONFIG, &config);
+    return ((config & 0x10) != 0);
+}
+
+
+/**
+ * @brief Read several 16-bit registers in one bus transaction.
+ *        The MCP9808 doesn't advance its register pointer, so each
+ *        register is a write-read with a repeated START, but the
+ *        reads run back to back without returning to the caller.
+ *
+ * @param device: The sensor.
+ * @param regs:   The register addresses.
+ * @param values: Where to write the register values.
+ * @param count:  The number of registers, up to `I2C_MAX_OPS`.
+ *
+ * @returns The HAL status of the transaction.
+ */
+HAL_StatusTypeDef MCP9808_read_registers(MCP9808_Device* device, const uint8_t* regs, uint16_t* values, uint8_t count) {
+
+    if (count == 0 || count > I2C_MAX_OPS) return HAL_ERROR;
+
+    uint8_t data[I2C_MAX_OPS][2] = {{0}};
+    I2C_Transaction transaction = {
+        .address = device->address,
+        .op_count = count,
+        .timeout_ms = 200
+    };
+
+    for (uint8_t i = 0 ; i < count ; ++i) {
+        transaction.ops[i] = (I2C_Op){ .type = I2C_OP_READ_REG, .reg = regs[i], .length = 2, .data = data[i] };
+    }
+
+    HAL_StatusTypeDef result = I2C_run(&transaction);
+    for (uint8_t i = 0 ; i < count ; ++i) {
+        values[i] = (data[i][0] << 8) | data[i][1];
+    }
+
+    return result;
+}
+
+
+/**
+ * @brief Mark every shadowed register as unknown, so the next access to
+ *        each reads it from the sensor, eg. after the sensor is reset.
+ *        Pending writes are dropped.
+ *
+ * @param device: The sensor.
+ */
+void MCP9808_invalidate_cache(MCP9808_Device* device) {
+
+    device->shadow.valid = 0;
+    device->shadow.dirty = 0;
+}
+
+
+/**
+ * @brief Read a register from the sensor, bypassing the shadow.
+ *
+ * @param device: The sensor.
+ * @param reg:    The register address.
+ * @param value:  Where to write the register value.
+ *
+ * @returns The HAL status of the transfer.
+ */
+static HAL_StatusTypeDef MCP9808_read_register(MCP9808_Device* device, uint8_t reg, uint16_t* value) {
+
+    uint8_t data[2] = {0};
+    const uint16_t length = MCP9808_register_length(reg);
+    HAL_StatusTypeDef result = I2C_read_register(device->address, reg, data, length, 200);
+    *value = (length == 1) ? data[0] : (data[0] << 8) | data[1];
+    return result;
+}
+
+
+/**
+ * @brief The size of a register: RESOLUTION is 8 bits, the rest 16 bits.
+ *
+ * @param reg: The register address.
+ *
+ * @returns The register size in bytes.
+ */
+static uint16_t MCP9808_register_length(uint8_t reg) {
+
+    return (reg == MCP9808_REG_RESOLUTION) ? 1 : 2;
+}
+
+
+/**
+ * @brief Look up a resolution's conversion time.
+ *
+ * @param resolution: The RESOLUTION register value.
+ *
+ * @returns The conversion time in milliseconds.
+ */
+static uint32_t MCP9808_conversion_ms(uint16_t resolution) {
+
+    return conversion_ms[resolution & 0x03];
+}
+
+
+/**
+ * @brief Find a register's shadow.
+ *
+ * @param reg: The register address.
+ *
+ * @returns The shadow index, or -1 if the register isn't shadowed.
+ */
+static int8_t MCP9808_shadow_index(uint8_t reg) {
+
+    for (uint8_t i = 0 ; i < MCP9808_SHADOW_COUNT ; ++i) {
+        if (shadow_regs[i] == reg) return (int8_t)i;
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Get a register's value: from its shadow, if that's valid,
+ *        otherwise from the sensor. Volatile CONFIG bits are cleared.
+ *
+ * @param device: The sensor.
+ * @param reg:    The register address.
+ * @param value:  Where to write the register value.
+ *
+ * @returns The HAL status of the read, or `HAL_OK` for a shadow hit.
+ */
+static HAL_StatusTypeDef MCP9808_get_register(MCP9808_Device* device, uint8_t reg, uint16_t* value) {
+
+    MCP9808_Shadow* shadow = &device->shadow;
+    const int8_t index = MCP9808_shadow_index(reg);
+    if (index < 0) return MCP9808_read_register(device, reg, value);
+
+    const uint8_t bit = 1 << index;
+    if ((shadow->valid & bit) == 0) {
+        uint16_t read_value = 0;
+        HAL_StatusTypeDef result = MCP9808_read_register(device, reg, &read_value);
+        if (result != HAL_OK) return result;
+
+        if (reg == MCP9808_REG_CONFIG) read_value &= ~MCP9808_CONFIG_VOLATILE_BITS;
+        shadow->regs[index] = read_value;
+        shadow->valid |= bit;
+    }
+
+    *value = shadow->regs[index];
+    return HAL_OK;
+}
+
+
+/**
+ * @brief Set a shadowed register's value, marking it dirty if it changes.
+ *        Call `MCP9808_flush()` to write it to the sensor.
+ *
+ * @param device: The sensor.
+ * @param reg:    The register address.
+ * @param value:  The register value.
+ */
+static void MCP9808_set_register(MCP9808_Device* device, uint8_t reg, uint16_t value) {
+
+    MCP9808_Shadow* shadow = &device->shadow;
+    const int8_t index = MCP9808_shadow_index(reg);
+    if (index < 0) return;
+
+    const uint8_t bit = 1 << index;
+    if ((shadow->valid & bit) && shadow->regs[index] == value) return;
+
+    shadow->regs[index] = value;
+    shadow->valid |= bit;
+    shadow->dirty |= bit;
+}
+
+
+/**
+ * @brief Write every dirty register to the sensor, as few transactions as
+ *        the bus manager allows. A register that fails to write stays dirty.
+ *
+ * @param device: The sensor.
+ * @param verify: `true` to read back each register after writing it. A
+ *                register which reads back wrong loses its shadow.
+ *
+ * @returns The HAL status of the last transaction.
+ */
+static HAL_StatusTypeDef MCP9808_flush(MCP9808_Device* device, bool verify) {
+
+    MCP9808_Shadow* shadow = &device->shadow;
+    HAL_StatusTypeDef result = HAL_OK;
+    uint8_t index = 0;
+
+    while (shadow->dirty != 0 && index < MCP9808_SHADOW_COUNT) {
+        uint8_t written[MCP9808_SHADOW_COUNT] = {0};
+        uint8_t data[MCP9808_SHADOW_COUNT][2] = {{0}};
+        uint8_t check[MCP9808_SHADOW_COUNT][2] = {{0}};
+        uint8_t count = 0;
+        I2C_Transaction transaction = {
+            .address = device->address,
+            .op_count = 0,
+            .timeout_ms = 200
+        };
+
+        // Fill a transaction with writes, each followed by its read-back if required
+        const uint8_t ops_per_register = verify ? 2 : 1;
+        for ( ; index < MCP9808_SHADOW_COUNT && transaction.op_count + ops_per_register <= I2C_MAX_OPS ; ++index) {
+            if ((shadow->dirty & (1 << index)) == 0) continue;
+
+            const uint8_t reg = shadow_regs[index];
+            const uint16_t length = MCP9808_register_length(reg);
+            const uint16_t value = shadow->regs[index];
+            data[count][0] = (length == 1) ? (uint8_t)(value & 0xFF) : (uint8_t)(value >> 8);
+            data[count][1] = (uint8_t)(value & 0xFF);
+
+            transaction.ops[transaction.op_count++] = (I2C_Op){ .type = I2C_OP_WRITE_REG, .reg = reg, .length = length, .data = data[count] };
+            if (verify) {
+                transaction.ops[transaction.op_count++] = (I2C_Op){ .type = I2C_OP_READ_REG, .reg = reg, .length = length, .data = check[count] };
+            }
+
+            written[count++] = index;
+        }
+
+        if (count == 0) break;
+
+        result = I2C_run(&transaction);
+        if (result != HAL_OK) {
+            server_error("MCP9808 0x%02x register write failed: %i", device->address, result);
+            continue;
+        }
+
+        for (uint8_t i = 0 ; i < count ; ++i) {
+            const uint8_t shadow_index = written[i];
+            const uint8_t bit = 1 << shadow_index;
+            shadow->dirty &= ~bit;
+            if (!verify) continue;
+
+            const uint8_t reg = shadow_regs[shadow_index];
+            uint16_t read_value = (MCP9808_register_length(reg) == 1) ? check[i][0] : (check[i][0] << 8) | check[i][1];
+            if (reg == MCP9808_REG_CONFIG) read_value &= ~MCP9808_CONFIG_VOLATILE_BITS;
+            if (read_value != shadow->regs[shadow_index]) {
+                server_error("MCP9808 0x%02x register 0x%02x mismatch. SET: %04x READ: %04x", device->address, reg, shadow->regs[shadow_index], read_value);
+                shadow->valid &= ~bit;
+            }
+        }
+    }
 
-    uint8_t config_data[3] = { MCP9808_REG_CONFIG, 0, 0 };
-    HAL_I2C_Master_Transmit(&i2c, MCP9808_ADDR << 1, config_data, 1, 100);
-    HAL_I2C_Master_Receive(&i2c, MCP9808_ADDR << 1, &config_data[1], 2, 200);
-    return ((config_data[2] & 0x10) != 0);
+    return result;
 }
\ No newline at end of file
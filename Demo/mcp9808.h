@@ -13,8 +13,18 @@
 /*
  *  CONSTANTS
  */
-// Sensor I2C address
+// Sensor I2C addresses: pins A0-A2 set the low three bits,
+// so up to eight sensors can share a bus
 #define MCP9808_ADDR                    0x18
+#define MCP9808_ADDR_COUNT              8
+#define MCP9808_MAX_DEVICES             MCP9808_ADDR_COUNT
+
+// Discovery: the pause between rounds of probes for missing sensors
+// doubles from the minimum to the maximum. Sensors whose reads fail this
+// many times in a row are taken offline until they are found again
+#define MCP9808_DISCOVER_MIN_MS         500
+#define MCP9808_DISCOVER_MAX_MS         60000
+#define MCP9808_OFFLINE_FAILURES        3
 
 // Register addresses
 #define MCP9808_REG_CONFIG              0x01
@@ -24,16 +34,70 @@
 #define MCP9808_REG_AMBIENT_TEMP        0x05
 #define MCP9808_REG_MANUF_ID            0x06
 #define MCP9808_REG_DEVICE_ID           0x07
+#define MCP9808_REG_RESOLUTION          0x08
 
-#define MCP9808_CONFIG_CLEAR_ALERT      0xDF
+// Writing 1 to CONFIG bit 5 clears a latched interrupt-mode alert
+#define MCP9808_CONFIG_CLEAR_ALERT      0x0020
 #define MCP9808_CONFIG_ENABLE_ALERT     0x08
 #define MCP9808_CONFIG_ALERT_POL        0x02
 #define MCP9808_CONFIG_ALERT_MODE       0x01
 
+// CONFIG bits which don't hold configuration: the alert output status,
+// and the interrupt clear bit, which always reads back as zero
+#define MCP9808_CONFIG_VOLATILE_BITS    0x0030
+
+// Resolution settings, each a trade of precision against conversion
+// time, ie. how soon a fresh reading is available. The sensor powers
+// up at its finest resolution
+#define MCP9808_RESOLUTION_0_5C         0x00    // Conversion time 30ms
+#define MCP9808_RESOLUTION_0_25C        0x01    // 65ms
+#define MCP9808_RESOLUTION_0_125C       0x02    // 130ms
+#define MCP9808_RESOLUTION_0_0625C      0x03    // 250ms
+#define MCP9808_RESOLUTION_DEFAULT      MCP9808_RESOLUTION_0_0625C
+
+// Registers shadowed by the driver: CONFIG, the three limits and RESOLUTION
+#define MCP9808_SHADOW_COUNT            5
+
 #define DEFAULT_TEMP_LOWER_LIMIT_C      10
 #define DEFAULT_TEMP_UPPER_LIMIT_C      30
 #define DEFAULT_TEMP_CRIT_LIMIT_C       50
 
+// Temperatures are fixed point, in 1/16°C -- the sensor's own resolution
+#define MCP9808_TEMP_SCALE              16
+
+// Buffer size for `MCP9808_format_temp()`, eg. "-128.00"
+#define MCP9808_TEMP_TEXT_LEN           8
+
+
+/*
+ *  TYPES
+ */
+// Shadow copies of a sensor's shadowed registers. A register is read
+// from the sensor only when its shadow isn't valid, and written only
+// when its shadow is dirty, ie. has changed since it was last written
+typedef struct {
+    uint16_t    regs[MCP9808_SHADOW_COUNT];
+    uint8_t     valid;
+    uint8_t     dirty;
+} MCP9808_Shadow;
+
+// A sensor's state. Sensors found by `MCP9808_discover()` are got
+// with `MCP9808_get_device()`; the fields are the driver's
+typedef struct {
+    uint8_t         address;
+    bool            online;
+    uint8_t         failures;
+    MCP9808_Shadow  shadow;
+    uint16_t        limit_lower;
+    uint16_t        limit_upper;
+    uint16_t        limit_critical;
+    // The sensor converts continuously, so a conversion completes within
+    // one conversion time of any moment. This is the tick by which a
+    // conversion that hasn't yet been read is certain to be ready
+    TickType_t      fresh_tick;
+    bool            fresh_tick_valid;
+} MCP9808_Device;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,13 +107,25 @@ extern "C" {
 /*
  *  PROTOTYPES
  */
-bool    MCP9808_init(void) ;
-double  MCP9808_read_temp(void);
-void    MCP9808_clear_alert(bool do_enable);
-void    MCP9808_set_upper_limit(uint16_t upper_temp);
-void    MCP9808_set_critical_limit(uint16_t critical_temp);
-void    MCP9808_set_lower_limit(uint16_t lower_temp);
-bool    MCP9808_get_alert_state(void);
+uint8_t MCP9808_discover(void);
+TickType_t MCP9808_next_discover_tick(TickType_t latest_tick);
+uint8_t MCP9808_get_device_count(void);
+MCP9808_Device* MCP9808_get_device(uint8_t slot);
+bool    MCP9808_init(MCP9808_Device* device, uint8_t address);
+HAL_StatusTypeDef MCP9808_read_temp(MCP9808_Device* device, int16_t* temp);
+uint8_t MCP9808_sweep(int16_t* temps, HAL_StatusTypeDef* results);
+TickType_t MCP9808_next_sweep_tick(TickType_t earliest_tick);
+char*   MCP9808_format_temp(int16_t temp, char* text);
+bool    MCP9808_set_resolution(MCP9808_Device* device, uint8_t resolution);
+uint32_t MCP9808_get_conversion_ms(MCP9808_Device* device);
+TickType_t MCP9808_next_read_tick(MCP9808_Device* device, TickType_t earliest_tick);
+void    MCP9808_clear_alert(MCP9808_Device* device, bool do_enable);
+void    MCP9808_set_upper_limit(MCP9808_Device* device, uint16_t upper_temp);
+void    MCP9808_set_critical_limit(MCP9808_Device* device, uint16_t critical_temp);
+void    MCP9808_set_lower_limit(MCP9808_Device* device, uint16_t lower_temp);
+bool    MCP9808_get_alert_state(MCP9808_Device* device);
+HAL_StatusTypeDef MCP9808_read_registers(MCP9808_Device* device, const uint8_t* regs, uint16_t* values, uint8_t count);
+void    MCP9808_invalidate_cache(MCP9808_Device* device);
 
 
 #ifdef __cplusplus
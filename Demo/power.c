@@ -0,0 +1,216 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * CONSTANTS
+ */
+// SysTick cycles lost while the timer is stopped to reprogram it, as
+// allowed for by the FreeRTOS Cortex-M33 port
+#define     POWER_STOPPED_TIMER_COMPENSATION    45
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+#if configUSE_TICKLESS_IDLE == 1 && !defined(HOST_BUILD)
+static void power_step_hal_tick(uint32_t tim6_start, bool tim6_pending, uint32_t slept_cycles);
+#endif
+
+
+/*
+ * GLOBALS
+ */
+static volatile PowerStats  power_stats = { 0 };
+static PowerStats           stats_logged = { 0 };
+static TickType_t           stats_logged_tick = 0;
+
+
+#if configUSE_TICKLESS_IDLE == 1 && !defined(HOST_BUILD)
+/**
+ * @brief Sleep the core while no task is ready to run. Replaces the FreeRTOS
+ *        port's weak `vPortSuppressTicksAndSleep()`, and is called by the idle
+ *        task through `portSUPPRESS_TICKS_AND_SLEEP()`.
+ *
+ *        SysTick is reprogrammed to fire when the next task is due, and the
+ *        HAL's TIM6 timebase is suspended too, so neither wakes the core each
+ *        millisecond. After waking, the kernel tick is stepped on by the
+ *        complete ticks slept, and the HAL tick by the TIM6 periods that
+ *        passed, as is the cycle counter. This follows the port's own
+ *        implementation, which only handles SysTick, except that interrupts
+ *        stay masked until all of them are correct: a handler which reads
+ *        `timestamp_us()` or `timestamp_cycles()`, eg. EXTI11's, would
+ *        otherwise get the time the sleep began.
+ *
+ *        NOTE SysTick is 24 bits wide, so one sleep can't last longer than
+ *             0xFFFFFF core clock cycles, eg. 104ms at 160MHz. Longer idle
+ *             periods are slept in as many pieces as that takes.
+ *
+ * @param expected_idle_ticks: The ticks until a task is next due to run.
+ */
+void vPortSuppressTicksAndSleep(TickType_t expected_idle_ticks) {
+
+    const uint32_t cycles_per_tick = configCPU_CLOCK_HZ / configTICK_RATE_HZ;
+    const TickType_t max_idle_ticks = SysTick_LOAD_RELOAD_Msk / cycles_per_tick;
+    if (expected_idle_ticks > max_idle_ticks) expected_idle_ticks = max_idle_ticks;
+
+    // Stop SysTick, and work out the reload value which makes it fire
+    // when the idle period ends, less the cycles it's stopped for
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t reload = SysTick->VAL + cycles_per_tick * (expected_idle_ticks - 1);
+    if (reload > POWER_STOPPED_TIMER_COMPENSATION) reload -= POWER_STOPPED_TIMER_COMPENSATION;
+
+    // Mask interrupts -- the core still wakes from WFI on a pending one
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    // Don't sleep if a task became ready, or a context switch
+    // was requested, since the idle task was chosen to run
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        // Restart SysTick from where it stopped, then put back its reload
+        SysTick->LOAD = SysTick->VAL;
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        SysTick->LOAD = cycles_per_tick - 1;
+        power_stats.aborted++;
+        __enable_irq();
+        return;
+    }
+
+    // Stop the HAL tick. TIM6 keeps counting: note where it starts,
+    // and whether a millisecond was already waiting to be counted
+    HAL_SuspendTick();
+    const uint32_t tim6_start = TIM6->CNT;
+    const bool tim6_pending = (TIM6->SR & TIM_SR_UIF) != 0;
+
+    SysTick->LOAD = reload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    const uint32_t cycles_start = DWT->CYCCNT;
+
+    // Interrupts stay masked after WFI: the interrupt which woke the core
+    // stays pending, and only runs once the ticks and cycle count have been
+    // corrected, so its handler reads the time after the sleep, not before
+    __DSB();
+    __WFI();
+    __ISB();
+    const uint32_t cycles_counted = DWT->CYCCNT - cycles_start;
+
+    // Stop SysTick, but don't clear its count flag before checking it
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+    uint32_t completed_ticks;
+    uint32_t slept_cycles;
+    if ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0) {
+        // SysTick woke the core: the idle period is over. Its interrupt is
+        // pending and will count the last tick, so reload the remainder of
+        // that tick, allowing for the cycles since it fired
+        const uint32_t since_fired = reload - SysTick->VAL;
+        uint32_t remainder = (cycles_per_tick - 1) - since_fired;
+        if (remainder < POWER_STOPPED_TIMER_COMPENSATION || remainder > cycles_per_tick) remainder = cycles_per_tick - 1;
+        SysTick->LOAD = remainder;
+        completed_ticks = expected_idle_ticks - 1;
+        slept_cycles = reload + 1 + since_fired;
+    } else {
+        // Another interrupt woke the core: count the complete ticks, and
+        // reload the part of the current one which hasn't yet passed
+        const uint32_t completed_cycles = (expected_idle_ticks * cycles_per_tick) - SysTick->VAL;
+        completed_ticks = completed_cycles / cycles_per_tick;
+        SysTick->LOAD = ((completed_ticks + 1) * cycles_per_tick) - completed_cycles;
+        slept_cycles = reload - SysTick->VAL;
+    }
+
+    // Restart SysTick, and step the kernel and HAL ticks on
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    vTaskStepTick(completed_ticks);
+    SysTick->LOAD = cycles_per_tick - 1;
+
+    power_step_hal_tick(tim6_start, tim6_pending, slept_cycles);
+    HAL_ResumeTick();
+
+    // Step the cycle counter on by any cycles it missed while the core slept
+    if (cycles_counted < slept_cycles) DWT->CYCCNT += slept_cycles - cycles_counted;
+
+    power_stats.sleeps++;
+    power_stats.sleep_ticks += completed_ticks;
+    if (completed_ticks > power_stats.max_sleep_ticks) power_stats.max_sleep_ticks = completed_ticks;
+
+    // Now let the interrupt which woke the core run
+    __enable_irq();
+}
+
+
+/**
+ * @brief Add the TIM6 periods which passed while the HAL tick was suspended
+ *        to the HAL tick. TIM6 only flags that it has wrapped, not how often,
+ *        so the sleep's length, timed by SysTick, gives the count: it need
+ *        only be accurate to half a period.
+ *
+ * @param tim6_start:   The TIM6 count when the HAL tick was suspended.
+ * @param tim6_pending: `true` if a TIM6 period had ended but not been counted.
+ * @param slept_cycles: The core clock cycles slept.
+ */
+static void power_step_hal_tick(uint32_t tim6_start, bool tim6_pending, uint32_t slept_cycles) {
+
+    const uint32_t period_us = TIM6->ARR + 1;
+    const uint32_t slept_us = slept_cycles / (configCPU_CLOCK_HZ / 1000000);
+    const int32_t counted_us = (int32_t)(tim6_start + slept_us) - (int32_t)TIM6->CNT;
+    const uint32_t periods = (counted_us > 0) ? ((uint32_t)counted_us + period_us / 2) / period_us : 0;
+
+    // Clear the update flag, so resuming the tick doesn't count it again
+    TIM6->SR = ~TIM_SR_UIF;
+    uwTick += (periods + (tim6_pending ? 1 : 0)) * uwTickFreq;
+}
+#endif
+
+
+/**
+ * @brief Get the tickless idle counters.
+ *
+ * @param stats: Where to write the counters.
+ */
+void power_get_stats(PowerStats* stats) {
+
+    if (stats == NULL) return;
+
+    taskENTER_CRITICAL();
+    *stats = power_stats;
+    taskEXIT_CRITICAL();
+}
+
+
+/**
+ * @brief Log how much of the time since the last call the core spent
+ *        asleep, and how often it woke: from sleep, and for the kernel
+ *        tick while awake. Without tickless idle, SysTick and TIM6 wake
+ *        it every tick.
+ */
+void power_log_stats(void) {
+
+    PowerStats stats;
+    power_get_stats(&stats);
+    const TickType_t now = xTaskGetTickCount();
+    const uint32_t ticks = now - stats_logged_tick;
+    if (ticks == 0) return;
+
+    const uint32_t sleeps = stats.sleeps - stats_logged.sleeps;
+    const uint32_t sleep_ticks = stats.sleep_ticks - stats_logged.sleep_ticks;
+    const uint32_t seconds = (ticks + configTICK_RATE_HZ / 2) / configTICK_RATE_HZ;
+    server_log("Power: asleep %lu%% of %lus, %lu wakeups/s, %lu awake ticks/s, longest sleep %lums",
+               (unsigned long)(((uint64_t)sleep_ticks * 100) / ticks),
+               (unsigned long)seconds,
+               (unsigned long)(((uint64_t)sleeps * configTICK_RATE_HZ) / ticks),
+               (unsigned long)(((uint64_t)(ticks - sleep_ticks) * configTICK_RATE_HZ) / ticks),
+               (unsigned long)(stats.max_sleep_ticks * portTICK_PERIOD_MS));
+
+    stats_logged = stats;
+    stats_logged_tick = now;
+}
@@ -0,0 +1,48 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef POWER_HEADER
+#define POWER_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+#define     POWER_STATS_INTERVAL_MS             60000
+
+
+/*
+ * TYPES
+ */
+// Tickless idle counters. Each sleep ends with one wakeup
+typedef struct {
+    uint32_t    sleeps;
+    uint32_t    aborted;
+    uint32_t    sleep_ticks;
+    uint32_t    max_sleep_ticks;
+} PowerStats;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void power_get_stats(PowerStats* stats);
+void power_log_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // POWER_HEADER
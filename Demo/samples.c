@@ -0,0 +1,227 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * TYPES
+ */
+typedef struct {
+    uint32_t    count;
+    int16_t     min;
+    int16_t     max;
+    int32_t     total;
+    TickType_t  start_tick;
+} SampleWindow;
+
+// A sensor's deadband mode state
+typedef struct {
+    int16_t     last_reported_temp;
+    TickType_t  last_reported_tick;
+    bool        has_reported;
+    uint32_t    suppressed_since_report;
+} SampleDeadband;
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static void samples_report(uint8_t sensor, TickType_t now);
+static void samples_report_delta(uint8_t sensor, int16_t temp, TickType_t now);
+
+
+/*
+ * GLOBALS
+ */
+// The ring holds the most recent SAMPLE_RING_SIZE samples: `sample_next`
+// is where the next one goes, and `sample_total` counts every sample added
+static Sample       samples[SAMPLE_RING_SIZE];
+static uint32_t     sample_next = 0;
+static uint32_t     sample_total = 0;
+static SampleWindow sample_windows[SAMPLE_MAX_SENSORS] = { 0 };
+
+static uint8_t              report_mode = SAMPLE_REPORT_MODE;
+static SampleReportStats    report_stats = { 0 };
+static SampleDeadband       deadbands[SAMPLE_MAX_SENSORS] = { 0 };
+
+
+/**
+ * @brief Add a temperature sample to the ring, timestamped with the
+ *        current tick, and report it according to the report mode.
+ *        In window mode, the sample is added to its sensor's current
+ *        window. If that closes the window, log its aggregate and start
+ *        a new one.
+ *
+ * @param sensor: The sensor's index, below SAMPLE_MAX_SENSORS.
+ * @param temp:   The temperature in 1/16°C.
+ */
+void samples_add(uint8_t sensor, int16_t temp) {
+
+    if (sensor >= SAMPLE_MAX_SENSORS) return;
+    const TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    samples[sample_next] = (Sample){ .tick = now, .sensor = sensor, .temp = temp };
+    sample_next = (sample_next + 1) % SAMPLE_RING_SIZE;
+    sample_total++;
+    taskEXIT_CRITICAL();
+
+    if (report_mode == SAMPLE_REPORT_DEADBAND) {
+        samples_report_delta(sensor, temp, now);
+        return;
+    }
+
+    SampleWindow* window = &sample_windows[sensor];
+    if (window->count == 0) {
+        *window = (SampleWindow){ .min = temp, .max = temp, .start_tick = now };
+    }
+
+    window->count++;
+    window->total += temp;
+    if (temp < window->min) window->min = temp;
+    if (temp > window->max) window->max = temp;
+
+    if (window->count >= SAMPLE_WINDOW_COUNT || now - window->start_tick >= pdMS_TO_TICKS(SAMPLE_WINDOW_MS)) {
+        samples_report(sensor, now);
+        window->count = 0;
+    }
+}
+
+
+/**
+ * @brief Select how samples are reported. Changing mode discards the
+ *        current windows, and each sensor's next sample is reported in
+ *        either mode.
+ *
+ * @param mode: `SAMPLE_REPORT_WINDOW` or `SAMPLE_REPORT_DEADBAND`.
+ */
+void samples_set_report_mode(uint8_t mode) {
+
+    if (mode != SAMPLE_REPORT_WINDOW && mode != SAMPLE_REPORT_DEADBAND) return;
+    report_mode = mode;
+    for (uint8_t i = 0 ; i < SAMPLE_MAX_SENSORS ; ++i) {
+        sample_windows[i].count = 0;
+        deadbands[i].has_reported = false;
+    }
+}
+
+
+/**
+ * @brief Get the deadband mode counters: how many readings were reported
+ *        for moving past the deadband, how many as heartbeats, and how many
+ *        were suppressed.
+ *
+ * @param stats: Where to write the counters.
+ */
+void samples_get_report_stats(SampleReportStats* stats) {
+
+    if (stats != NULL) *stats = report_stats;
+}
+
+
+/**
+ * @brief Get the number of samples in the ring.
+ *
+ * @returns The sample count, up to SAMPLE_RING_SIZE.
+ */
+uint32_t samples_count(void) {
+
+    return (sample_total < SAMPLE_RING_SIZE) ? sample_total : SAMPLE_RING_SIZE;
+}
+
+
+/**
+ * @brief Get a sample from the ring's history.
+ *
+ * @param age:    The sample's age: 0 for the latest, 1 for the one before, etc.
+ * @param sample: Where to write the sample.
+ *
+ * @returns `true` if the ring holds a sample of that age, otherwise `false`.
+ */
+bool samples_get(uint32_t age, Sample* sample) {
+
+    if (sample == NULL) return false;
+
+    bool got_sample = false;
+    taskENTER_CRITICAL();
+    if (age < samples_count()) {
+        *sample = samples[(sample_next + SAMPLE_RING_SIZE - 1 - age) % SAMPLE_RING_SIZE];
+        got_sample = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return got_sample;
+}
+
+
+/**
+ * @brief Log the aggregate of a sensor's current window.
+ *
+ * @param sensor: The sensor's index.
+ * @param now:    The tick of the window's last sample.
+ */
+static void samples_report(uint8_t sensor, TickType_t now) {
+
+    const SampleWindow* window = &sample_windows[sensor];
+
+    // Round the mean to the nearest 1/16°C
+    const int32_t half = (int32_t)window->count / 2;
+    const int32_t total = window->total;
+    const int16_t mean = (int16_t)((total + (total < 0 ? -half : half)) / (int32_t)window->count);
+
+    char min_text[MCP9808_TEMP_TEXT_LEN];
+    char mean_text[MCP9808_TEMP_TEXT_LEN];
+    char max_text[MCP9808_TEMP_TEXT_LEN];
+    server_report("Sensor %u temperature over %lus: %lu samples, min %s°C, mean %s°C, max %s°C",
+                  sensor,
+                  (unsigned long)((now - window->start_tick) / configTICK_RATE_HZ),
+                  (unsigned long)window->count,
+                  MCP9808_format_temp(window->min, min_text),
+                  MCP9808_format_temp(mean, mean_text),
+                  MCP9808_format_temp(window->max, max_text));
+}
+
+
+/**
+ * @brief Report a sample in deadband mode: log it if it has moved more
+ *        than the deadband from its sensor's last reported sample, or if
+ *        that report is a heartbeat interval old, otherwise just count it.
+ *
+ * @param sensor: The sensor's index.
+ * @param temp:   The temperature in 1/16°C.
+ * @param now:    The sample's tick.
+ */
+static void samples_report_delta(uint8_t sensor, int16_t temp, TickType_t now) {
+
+    SampleDeadband* deadband = &deadbands[sensor];
+    const int32_t delta = (int32_t)temp - (int32_t)deadband->last_reported_temp;
+    const bool is_change = !deadband->has_reported || delta > SAMPLE_DEADBAND || delta < -SAMPLE_DEADBAND;
+    const bool is_heartbeat = !is_change && now - deadband->last_reported_tick >= pdMS_TO_TICKS(SAMPLE_HEARTBEAT_MS);
+
+    if (!is_change && !is_heartbeat) {
+        report_stats.suppressed++;
+        deadband->suppressed_since_report++;
+        return;
+    }
+
+    if (is_heartbeat) {
+        report_stats.heartbeats++;
+    } else {
+        report_stats.reported++;
+    }
+
+    char temp_text[MCP9808_TEMP_TEXT_LEN];
+    server_report("Sensor %u temperature: %s°C (%lu within deadband since last report)",
+                  sensor, MCP9808_format_temp(temp, temp_text), (unsigned long)deadband->suppressed_since_report);
+
+    deadband->last_reported_temp = temp;
+    deadband->last_reported_tick = now;
+    deadband->has_reported = true;
+    deadband->suppressed_since_report = 0;
+}
@@ -0,0 +1,82 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef SAMPLES_HEADER
+#define SAMPLES_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+// Temperature samples kept in the ring, set in `CMakeLists.txt`.
+// Every sensor's samples share the ring
+#ifndef SAMPLE_RING_SIZE
+#define     SAMPLE_RING_SIZE                    64
+#endif
+
+// Each sensor has its own window and deadband state
+#define     SAMPLE_MAX_SENSORS                  MCP9808_MAX_DEVICES
+
+// Samples are reported as the aggregate of a window, which closes
+// after SAMPLE_WINDOW_COUNT samples or SAMPLE_WINDOW_MS, whichever
+// comes first
+#define     SAMPLE_WINDOW_COUNT                 10
+#define     SAMPLE_WINDOW_MS                    120000
+
+// Report modes: the aggregate of each window, or readings which move
+// more than SAMPLE_DEADBAND (in 1/16°C) from the last reported reading,
+// plus one at least every SAMPLE_HEARTBEAT_MS
+#define     SAMPLE_REPORT_WINDOW                0
+#define     SAMPLE_REPORT_DEADBAND              1
+
+#ifndef SAMPLE_REPORT_MODE
+#define     SAMPLE_REPORT_MODE                  SAMPLE_REPORT_WINDOW
+#endif
+
+#define     SAMPLE_DEADBAND                     8
+#define     SAMPLE_HEARTBEAT_MS                 600000
+
+
+/*
+ * TYPES
+ */
+typedef struct {
+    TickType_t  tick;
+    uint8_t     sensor;
+    int16_t     temp;
+} Sample;
+
+// Deadband mode counters
+typedef struct {
+    uint32_t    reported;
+    uint32_t    heartbeats;
+    uint32_t    suppressed;
+} SampleReportStats;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void        samples_add(uint8_t sensor, int16_t temp);
+uint32_t    samples_count(void);
+bool        samples_get(uint32_t age, Sample* sample);
+void        samples_set_report_mode(uint8_t mode);
+void        samples_get_report_stats(SampleReportStats* stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // SAMPLES_HEADER
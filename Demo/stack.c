@@ -0,0 +1,92 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static uint32_t stack_depth_of(const char* name);
+
+
+/*
+ * GLOBALS
+ */
+static TaskStatus_t stack_tasks[STACK_MAX_TASKS];
+
+// The stack depth each task is created with. The timer service task's
+// name is set in FreeRTOS' `timers.c`
+static const StackTask stack_depths[] = {
+    { "LED_TASK",               TASK_LED_STACK_SIZE },
+    { "WORK_TASK",              TASK_SENSOR_STACK_SIZE },
+    { "ALERT_TASK",             ALERT_TASK_STACK_SIZE },
+    { "LOG_TASK",               LOG_TASK_STACK_SIZE },
+    { "I2C_TASK",               I2C_TASK_STACK_SIZE },
+    { configIDLE_TASK_NAME,     configMINIMAL_STACK_SIZE },
+    { "Tmr Svc",                configTIMER_TASK_STACK_DEPTH },
+};
+
+
+/**
+ * @brief Log the most of its stack each task has used, from its high-water
+ *        mark, and a recommended stack size: the most used plus
+ *        `STACK_MARGIN_PERCENT`. A task which has come within
+ *        `STACK_MIN_FREE_WORDS` of the end of its stack is logged as an error.
+ *        A summary gives the total allocated and the total recommended.
+ *
+ *        NOTE A high-water mark only covers the paths the task has taken so
+ *             far. Compare the recommendations with the worst case worked
+ *             out from the build's `-fstack-usage` output by
+ *             `Tools/stack_usage.py`, which reads these lines from the log.
+ *             On the host, tasks run on thread stacks, so the marks mean little.
+ */
+void stack_log_stats(void) {
+
+    const UBaseType_t count = uxTaskGetSystemState(stack_tasks, STACK_MAX_TASKS, NULL);
+
+    uint32_t allocated = 0;
+    uint32_t recommended = 0;
+    for (UBaseType_t i = 0 ; i < count ; ++i) {
+        const uint32_t depth = stack_depth_of(stack_tasks[i].pcTaskName);
+        if (depth == 0) continue;
+
+        const uint32_t free_words = stack_tasks[i].usStackHighWaterMark;
+        const uint32_t used = (free_words < depth) ? depth - free_words : 0;
+        uint32_t recommend = (used * (100 + STACK_MARGIN_PERCENT) + 99) / 100;
+        recommend = ((recommend + STACK_ROUND_WORDS - 1) / STACK_ROUND_WORDS) * STACK_ROUND_WORDS;
+
+        server_report("Stack %s: %lu of %lu words used, recommend %lu", stack_tasks[i].pcTaskName,
+                      (unsigned long)used, (unsigned long)depth, (unsigned long)recommend);
+        if (free_words < STACK_MIN_FREE_WORDS) {
+            server_error("Stack %s: only %lu words free", stack_tasks[i].pcTaskName, (unsigned long)free_words);
+        }
+
+        allocated += depth;
+        recommended += recommend;
+    }
+
+    server_log("Stacks: %lu words allocated, %lu recommended", (unsigned long)allocated, (unsigned long)recommended);
+}
+
+
+/**
+ * @brief Look up the stack depth a task was created with.
+ *
+ * @param name: The task's name.
+ *
+ * @returns The depth in words, or 0 for an unknown task.
+ */
+static uint32_t stack_depth_of(const char* name) {
+
+    for (uint32_t i = 0 ; i < sizeof(stack_depths) / sizeof(stack_depths[0]) ; ++i) {
+        if (strcmp(stack_depths[i].name, name) == 0) return stack_depths[i].depth;
+    }
+
+    return 0;
+}
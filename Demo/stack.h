@@ -0,0 +1,56 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef STACK_HEADER
+#define STACK_HEADER
+
+
+/*
+ * CONSTANTS
+ */
+#define     STACK_STATS_INTERVAL_MS             600000
+
+// Recommended stack sizes are the most a task has used plus this
+// margin, rounded up to a multiple of STACK_ROUND_WORDS
+#define     STACK_MARGIN_PERCENT                25
+#define     STACK_ROUND_WORDS                   32
+
+// An error is logged for a task whose stack has ever had less free
+#define     STACK_MIN_FREE_WORDS                64
+
+// Tasks the report covers, including the idle and timer service tasks
+#define     STACK_MAX_TASKS                     12
+
+
+/*
+ * TYPES
+ */
+// A task's stack depth, in words, as set when it was created
+typedef struct {
+    const char* name;
+    uint32_t    depth;
+} StackTask;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void stack_log_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // STACK_HEADER
@@ -0,0 +1,90 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+/**
+ * @brief Get a microsecond timestamp for measuring intervals.
+ *
+ *        The HAL timebase runs TIM6 at 1MHz and counts milliseconds with
+ *        its update interrupt, so the time is the HAL tick plus the TIM6
+ *        count. If TIM6 has wrapped but its interrupt has yet to run, eg.
+ *        because interrupts are masked, the pending millisecond is added.
+ *        On the host, this reads the monotonic clock.
+ *
+ *        NOTE The value wraps every 71.6 minutes: subtract timestamps
+ *             as `uint32_t`s to get intervals.
+ *
+ * @returns Microseconds since `HAL_Init()`.
+ */
+uint32_t timestamp_us(void) {
+
+#ifdef HOST_BUILD
+    return (uint32_t)host_elapsed_us();
+#else
+    uint32_t ms, count;
+    do {
+        ms = HAL_GetTick();
+        count = TIM6->CNT;
+        if (TIM6->SR & TIM_SR_UIF) {
+            count = TIM6->CNT;
+            ms++;
+        }
+    } while (ms != HAL_GetTick());
+
+    return ms * 1000 + count;
+#endif
+}
+
+
+/**
+ * @brief Start the core's cycle counter, `DWT->CYCCNT`. Call once at boot.
+ *
+ *        The counter stops while the core sleeps: `power.c` adds the
+ *        cycles slept before any interrupt handler can read it.
+ */
+void timestamp_cycles_init(void) {
+
+#ifndef HOST_BUILD
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+
+/**
+ * @brief Get a core clock cycle count for timing short intervals, eg. from
+ *        an interrupt to the task it wakes. On the host, the monotonic
+ *        clock stands in for it, scaled to `SystemCoreClock`.
+ *
+ *        NOTE The value wraps every 26.8s at 160MHz: subtract counts
+ *             as `uint32_t`s, and only for intervals shorter than that.
+ *
+ * @returns The cycle count.
+ */
+uint32_t timestamp_cycles(void) {
+
+#ifdef HOST_BUILD
+    return (uint32_t)(host_elapsed_us() * timestamp_cycles_per_us());
+#else
+    return DWT->CYCCNT;
+#endif
+}
+
+
+/**
+ * @brief Get the cycles in a microsecond.
+ *
+ * @returns The core clock in MHz.
+ */
+uint32_t timestamp_cycles_per_us(void) {
+
+    return SystemCoreClock / 1000000;
+}
@@ -0,0 +1,32 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef TIMESTAMP_HEADER
+#define TIMESTAMP_HEADER
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+uint32_t timestamp_us(void);
+void     timestamp_cycles_init(void);
+uint32_t timestamp_cycles(void);
+uint32_t timestamp_cycles_per_us(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // TIMESTAMP_HEADER
@@ -0,0 +1,178 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include "main.h"
+
+
+#if TRACE_RECORDER
+/*
+ * The kernel's trace macros, set in `FreeRTOSConfig.h`, and the interrupt
+ * handlers record events here: task switches, task notifications, timer
+ * commands and interrupts. Each event is eight bytes, stamped with the
+ * core's cycle counter, and goes into a RAM ring buffer, overwriting the
+ * oldest. The cycle counter is corrected after tickless sleep before any
+ * interrupt runs, so events recorded by a wake interrupt are stamped
+ * right. Writers claim slots with an atomic increment, so recording
+ * needs no lock and is safe from any context.
+ *
+ * `trace_trigger()` marks a moment of interest, eg. an alert. Once
+ * `TRACE_POST_TRIGGER_EVENTS` more events have been recorded, the buffer
+ * is frozen, and `trace_dump()` logs it, with the task names, for
+ * `Tools/trace_decoder.py` to turn into a timeline. Recording then resumes.
+ */
+_Static_assert((TRACE_BUFFER_EVENTS & (TRACE_BUFFER_EVENTS - 1)) == 0, "TRACE_BUFFER_EVENTS must be a power of two");
+_Static_assert(TRACE_DUMP_LINE_B % 3 == 0 && TRACE_DUMP_LINE_B % sizeof(TraceEvent) == 0, "TRACE_DUMP_LINE_B must hold whole events");
+
+
+/*
+ * GLOBALS
+ */
+static TraceEvent           trace_buffer[TRACE_BUFFER_EVENTS];
+static uint32_t             trace_head = 0;
+
+// Events left to record after a trigger, or 0 if there's no trigger
+static uint32_t             trace_remaining = 0;
+static volatile bool        trace_frozen = false;
+
+// Task numbers given out so far: see `trace_task_created()`
+static UBaseType_t          trace_task_count = 0;
+
+
+/**
+ * @brief Record an event. Safe to call from tasks, interrupts and
+ *        the kernel's trace macros.
+ *
+ * @param type: The event type, eg. `TRACE_EVENT_ISR_ENTER`.
+ * @param task: The task number, or 0.
+ * @param arg:  The event's argument.
+ */
+void trace_record(uint8_t type, uint8_t task, uint16_t arg) {
+
+    if (trace_frozen) return;
+
+    const uint32_t slot = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) & (TRACE_BUFFER_EVENTS - 1);
+    trace_buffer[slot] = (TraceEvent){ timestamp_cycles(), type, task, arg };
+
+    // Freeze the buffer once the events after a trigger are in
+    if (__atomic_load_n(&trace_remaining, __ATOMIC_RELAXED) > 0
+        && __atomic_sub_fetch(&trace_remaining, 1, __ATOMIC_RELAXED) == 0) {
+        trace_frozen = true;
+    }
+}
+
+
+/**
+ * @brief Record an event for a task.
+ *
+ * @param type: The event type, eg. `TRACE_EVENT_TASK_IN`.
+ * @param task: The task's handle, or `NULL` for the running task.
+ * @param arg:  The event's argument.
+ */
+void trace_record_task(uint8_t type, void* task, uint16_t arg) {
+
+    if (trace_frozen) return;
+    if (task == NULL) task = xTaskGetCurrentTaskHandle();
+    trace_record(type, (uint8_t)uxTaskGetTaskNumber((TaskHandle_t)task), arg);
+}
+
+
+/**
+ * @brief Give a new task the next task number, which its events carry.
+ *        Called by the kernel's `traceTASK_CREATE()` macro.
+ *
+ * @param task: The new task's handle.
+ */
+void trace_task_created(void* task) {
+
+    vTaskSetTaskNumber((TaskHandle_t)task, ++trace_task_count);
+}
+
+
+/**
+ * @brief Mark a moment of interest: the buffer is frozen for a dump
+ *        `TRACE_POST_TRIGGER_EVENTS` events later. Ignored while an
+ *        earlier trigger is pending.
+ */
+void trace_trigger(void) {
+
+    uint32_t expected = 0;
+    if (trace_frozen) return;
+    if (__atomic_compare_exchange_n(&trace_remaining, &expected, TRACE_POST_TRIGGER_EVENTS, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        trace_record_task(TRACE_EVENT_TRIGGER, NULL, 0);
+    }
+}
+
+
+/**
+ * @brief If the buffer is frozen, log it, then resume recording.
+ *        Call periodically from a task: it blocks while the dump is logged.
+ *
+ *        The dump is a header line, which gives the cycle counter's rate,
+ *        a line per task mapping its number to its name, then the events,
+ *        oldest first, as Base64 lines which each give their byte offset.
+ */
+void trace_dump(void) {
+
+    if (!trace_frozen) return;
+
+    const uint32_t head = trace_head;
+    const uint32_t count = (head < TRACE_BUFFER_EVENTS) ? head : TRACE_BUFFER_EVENTS;
+    const uint32_t first = head - count;
+    server_report("Trace dump: %lu events, %lu overwritten, %lu cycles/us", (unsigned long)count,
+                  (unsigned long)first, (unsigned long)timestamp_cycles_per_us());
+
+    TaskStatus_t tasks[TRACE_MAX_TASKS];
+    const UBaseType_t task_count = uxTaskGetSystemState(tasks, TRACE_MAX_TASKS, NULL);
+    for (UBaseType_t i = 0 ; i < task_count ; ++i) {
+        server_report("Trace task %lu: %s", (unsigned long)uxTaskGetTaskNumber(tasks[i].xHandle), tasks[i].pcTaskName);
+    }
+
+    // Gather the events in order, so each line encodes whole events
+    uint8_t line[TRACE_DUMP_LINE_B];
+    char text[4 * (TRACE_DUMP_LINE_B / 3) + 1];
+    uint32_t lines = 0;
+    for (uint32_t offset = 0 ; offset < count * sizeof(TraceEvent) ; offset += TRACE_DUMP_LINE_B) {
+        uint32_t length = 0;
+        while (length < TRACE_DUMP_LINE_B && offset + length < count * sizeof(TraceEvent)) {
+            const uint32_t index = (first + (offset + length) / sizeof(TraceEvent)) & (TRACE_BUFFER_EVENTS - 1);
+            memcpy(&line[length], &trace_buffer[index], sizeof(TraceEvent));
+            length += sizeof(TraceEvent);
+        }
+
+        text[log_base64(line, (uint16_t)length, text)] = '\0';
+        server_report("Trace data %lu: %s", (unsigned long)offset, text);
+        if (++lines % TRACE_DUMP_LINES_PER_PAUSE == 0) vTaskDelay(pdMS_TO_TICKS(TRACE_DUMP_PAUSE_MS));
+    }
+
+    server_report("Trace end");
+
+    // Resume recording from an empty buffer
+    trace_head = 0;
+    trace_frozen = false;
+}
+#else
+void trace_record(uint8_t type, uint8_t task, uint16_t arg) {
+}
+
+
+void trace_record_task(uint8_t type, void* task, uint16_t arg) {
+}
+
+
+void trace_task_created(void* task) {
+}
+
+
+void trace_trigger(void) {
+}
+
+
+void trace_dump(void) {
+}
+#endif
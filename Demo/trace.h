@@ -0,0 +1,88 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef TRACE_HEADER
+#define TRACE_HEADER
+
+#include "trace_events.h"
+
+
+/*
+ * CONSTANTS
+ */
+// Kernel trace recording: see `trace.c`. Set in `CMakeLists.txt`
+#ifndef TRACE_RECORDER
+#define     TRACE_RECORDER                      0
+#endif
+
+// Events the ring buffer holds (must be a power of two), and how many
+// are recorded after a trigger before the buffer is frozen for a dump
+#define     TRACE_BUFFER_EVENTS                 256
+#define     TRACE_POST_TRIGGER_EVENTS           64
+
+// Bytes of events per dump line (a multiple of three, so each line
+// Base64-encodes on its own). Tokenized logging truncates strings
+#if LOG_TOKENIZED
+#define     TRACE_DUMP_LINE_B                   24
+#else
+#define     TRACE_DUMP_LINE_B                   72
+#endif
+
+// The dump pauses after every few lines to let the log task keep up
+#define     TRACE_DUMP_LINES_PER_PAUSE          8
+#define     TRACE_DUMP_PAUSE_MS                 500
+
+#define     TRACE_MAX_TASKS                     12
+
+
+/*
+ * MACROS
+ */
+// Bracket an interrupt handler's work. Removed from the build
+// when the recorder is off
+#if TRACE_RECORDER
+#define TRACE_ISR_ENTER(irq)                    trace_record(TRACE_EVENT_ISR_ENTER, 0, (uint16_t)(irq))
+#define TRACE_ISR_EXIT(irq)                     trace_record(TRACE_EVENT_ISR_EXIT, 0, (uint16_t)(irq))
+#else
+#define TRACE_ISR_ENTER(irq)
+#define TRACE_ISR_EXIT(irq)
+#endif
+
+
+/*
+ * TYPES
+ */
+typedef struct {
+    uint32_t    time_cycles;
+    uint8_t     type;
+    uint8_t     task;
+    uint16_t    arg;
+} TraceEvent;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+void        trace_record(uint8_t type, uint8_t task, uint16_t arg);
+void        trace_record_task(uint8_t type, void* task, uint16_t arg);
+void        trace_task_created(void* task);
+void        trace_trigger(void);
+void        trace_dump(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // TRACE_HEADER
@@ -0,0 +1,52 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Controls for the host build's simulated hardware
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+#include "stm32u585xx.h"
+
+
+/*
+ * CONSTANTS
+ */
+// Simulated MCP9808 addresses and identity. Sensors answer at
+// consecutive addresses from HOST_MCP9808_ADDR
+#define HOST_MCP9808_ADDR               0x18
+#define HOST_MCP9808_MAX_SENSORS        8
+#define HOST_MCP9808_MANUF_ID           0x0054
+#define HOST_MCP9808_DEVICE_ID          0x0400
+
+// Each simulated sensor reads this much warmer than the one before
+#define HOST_SENSOR_STEP_C              0.5
+
+// I2C1 runs at 400kHz: 2.5us per bit, nine bits per byte with ACK
+#define HOST_I2C_NS_PER_BYTE            22500
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * PROTOTYPES
+ */
+uint64_t    host_elapsed_us(void);
+void        host_raise_irq(IRQn_Type irq);
+void        host_assert_failed(const char* file, int line);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // HOST_SIM_H
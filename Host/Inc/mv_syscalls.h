@@ -0,0 +1,46 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Host stand-in for the Microvisor system calls used by the demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef MV_SYSCALLS_H
+#define MV_SYSCALLS_H
+
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * TYPES
+ */
+enum MvStatus {
+    MV_STATUS_OKAY              = 0,
+    MV_STATUS_PARAMETERFAULT    = 3,
+    MV_STATUS_LOGGINGNOTSTARTED = 0x2C
+};
+
+
+/*
+ * PROTOTYPES
+ */
+enum MvStatus mvServerLoggingInit(uint8_t* buffer, uint32_t length);
+enum MvStatus mvServerLog(const uint8_t* text, uint16_t length);
+enum MvStatus mvGetHClk(uint32_t* hclk);
+enum MvStatus mvGetPClk1(uint32_t* pclk1);
+enum MvStatus mvGetDeviceId(uint8_t* buffer, uint32_t length);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // MV_SYSCALLS_H
@@ -0,0 +1,72 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Host stand-in for the CMSIS STM32U585 device header
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef STM32U585XX_H
+#define STM32U585XX_H
+
+#include <stdint.h>
+
+
+/*
+ * CONSTANTS
+ */
+#define __NVIC_PRIO_BITS        4
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * TYPES
+ */
+typedef enum {
+    TIM6_IRQn                   = 49,
+    EXTI11_IRQn                 = 22,
+    I2C1_EV_IRQn                = 55,
+    I2C1_ER_IRQn                = 56,
+    HOST_IRQ_COUNT              = 64
+} IRQn_Type;
+
+typedef struct {
+    uint32_t    ODR;
+    uint32_t    IDR;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t    ISR;
+} I2C_TypeDef;
+
+
+/*
+ * GLOBALS
+ */
+extern GPIO_TypeDef     host_gpioa;
+extern GPIO_TypeDef     host_gpiob;
+extern I2C_TypeDef      host_i2c1;
+extern uint32_t         SystemCoreClock;
+
+#define GPIOA           (&host_gpioa)
+#define GPIOB           (&host_gpiob)
+#define I2C1            (&host_i2c1)
+
+
+/*
+ * PROTOTYPES
+ */
+void SystemCoreClockUpdate(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // STM32U585XX_H
@@ -0,0 +1,173 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Host stand-in for the subset of the STM32U5 HAL used by the demo
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef STM32U5xx_HAL_H
+#define STM32U5xx_HAL_H
+
+#include <stdint.h>
+#include "stm32u585xx.h"
+
+
+/*
+ * CONSTANTS
+ */
+#define UNUSED(X)                       (void)X
+
+#define TICK_INT_PRIORITY               15U
+#define NVIC_PRIORITYGROUP_4            0x00000003U
+
+// GPIO
+#define GPIO_PIN_5                      ((uint16_t)0x0020)
+#define GPIO_PIN_6                      ((uint16_t)0x0040)
+#define GPIO_PIN_9                      ((uint16_t)0x0200)
+#define GPIO_PIN_11                     ((uint16_t)0x0800)
+
+#define GPIO_MODE_OUTPUT_PP             0x00000001U
+#define GPIO_MODE_AF_OD                 0x00000012U
+#define GPIO_MODE_IT_FALLING            0x10220000U
+#define GPIO_NOPULL                     0x00000000U
+#define GPIO_PULLUP                     0x00000001U
+#define GPIO_SPEED_FREQ_LOW             0x00000000U
+#define GPIO_SPEED_FREQ_VERY_HIGH       0x00000003U
+#define GPIO_AF4_I2C1                   ((uint8_t)0x04)
+
+// I2C
+#define I2C_ADDRESSINGMODE_7BIT         0x00000001U
+#define I2C_DUALADDRESS_DISABLE         0x00000000U
+#define I2C_OA2_NOMASK                  ((uint8_t)0x00U)
+#define I2C_GENERALCALL_DISABLE         0x00000000U
+#define I2C_NOSTRETCH_ENABLE            0x00020000U
+
+#define HAL_I2C_ERROR_NONE              0x00000000U
+#define HAL_I2C_ERROR_AF                0x00000004U
+#define I2C_FIRST_FRAME                 0x00000000U
+#define I2C_FIRST_AND_LAST_FRAME        0x02000000U
+#define I2C_LAST_FRAME                  0x02000000U
+#define I2C_MEMADD_SIZE_8BIT            0x00000001U
+
+// RCC
+#define RCC_PERIPHCLK_I2C1              0x00000010U
+#define RCC_I2C1CLKSOURCE_PCLK1         0x00000000U
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()    do {} while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()    do {} while (0)
+#define __HAL_RCC_I2C1_CLK_ENABLE()     do {} while (0)
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * TYPES
+ */
+typedef enum {
+    HAL_OK      = 0x00,
+    HAL_ERROR   = 0x01,
+    HAL_BUSY    = 0x02,
+    HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    uint32_t    Pin;
+    uint32_t    Mode;
+    uint32_t    Pull;
+    uint32_t    Speed;
+    uint32_t    Alternate;
+} GPIO_InitTypeDef;
+
+typedef struct {
+    uint32_t    Timing;
+    uint32_t    OwnAddress1;
+    uint32_t    AddressingMode;
+    uint32_t    DualAddressMode;
+    uint32_t    OwnAddress2;
+    uint32_t    OwnAddress2Masks;
+    uint32_t    GeneralCallMode;
+    uint32_t    NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef struct __I2C_HandleTypeDef {
+    I2C_TypeDef*        Instance;
+    I2C_InitTypeDef     Init;
+    volatile uint32_t   ErrorCode;
+} I2C_HandleTypeDef;
+
+typedef struct {
+    uint32_t    PeriphClockSelection;
+    uint32_t    I2c1ClockSelection;
+} RCC_PeriphCLKInitTypeDef;
+
+
+/*
+ * PROTOTYPES
+ */
+// Core
+HAL_StatusTypeDef   HAL_Init(void);
+HAL_StatusTypeDef   HAL_InitTick(uint32_t TickPriority);
+void                HAL_IncTick(void);
+uint32_t            HAL_GetTick(void);
+void                HAL_Delay(uint32_t Delay);
+void                HAL_SuspendTick(void);
+void                HAL_ResumeTick(void);
+
+// NVIC
+void                HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup);
+void                HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void                HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void                HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+// RCC
+HAL_StatusTypeDef   HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef* PeriphClkInit);
+
+// GPIO
+void                HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init);
+void                HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState       HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void                HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void                HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin);
+void                HAL_GPIO_EXTI_Falling_Callback(uint16_t GPIO_Pin);
+
+// I2C
+HAL_StatusTypeDef   HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef   HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef   HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef   HAL_I2C_Master_Receive(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef   HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t XferOptions);
+HAL_StatusTypeDef   HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t XferOptions);
+HAL_StatusTypeDef   HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress);
+HAL_StatusTypeDef   HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef   HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef   HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef   HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+void                HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+void                HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef   HAL_I2C_IsDeviceReady(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout);
+uint32_t            HAL_I2C_GetError(I2C_HandleTypeDef* hi2c);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  // STM32U5xx_HAL_H
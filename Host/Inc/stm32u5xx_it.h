@@ -0,0 +1,19 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Host stand-in for the STM32U5 interrupt handler header
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#ifndef STM32U5xx_IT_H
+#define STM32U5xx_IT_H
+
+#include "stm32u585xx.h"
+#include "host_sim.h"
+
+// NOTE The demo's own handlers are prototyped in `main.h`
+
+
+#endif  // STM32U5xx_IT_H
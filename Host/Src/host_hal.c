@@ -0,0 +1,925 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Host stand-ins for the STM32U5 HAL, plus a simulated MCP9808
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+// FreeRTOS
+#include <FreeRTOS.h>
+#include <task.h>
+// Host
+#include "stm32u5xx_hal.h"
+#include "host_sim.h"
+
+
+/*
+ * TYPES
+ */
+// A simulated MCP9808's registers
+typedef struct {
+    volatile uint16_t   regs[9];
+    uint8_t             pointer;
+    double              offset_temp;
+} SimSensor;
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static void         sim_init(void);
+static double       sim_temp_now(const SimSensor* sensor);
+static double       sim_converted_temp(const SimSensor* sensor);
+static uint16_t     sim_encode_temp(const SimSensor* sensor, double temp);
+static double       sim_decode_limit(uint16_t value);
+static bool         sim_alert_condition(const SimSensor* sensor);
+static SimSensor*   sim_addressed(uint16_t dev_address);
+static HAL_StatusTypeDef sim_write(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint8_t* data, uint16_t size);
+static HAL_StatusTypeDef sim_read(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint8_t* data, uint16_t size);
+static HAL_StatusTypeDef sim_mem_write(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint16_t mem_address, uint8_t* data, uint16_t size);
+static HAL_StatusTypeDef sim_mem_read(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint16_t mem_address, uint8_t* data, uint16_t size);
+static HAL_StatusTypeDef sim_start_transfer(I2C_HandleTypeDef* hi2c, HAL_StatusTypeDef result, bool is_read, bool is_mem, uint16_t bytes);
+static uint64_t     sim_bus_time_us(uint16_t bytes);
+static void         sim_bus_time(uint16_t bytes);
+static void         *run_limit_thread(void *argument);
+static void         print_stats(void);
+
+
+/*
+ * GLOBALS
+ */
+GPIO_TypeDef    host_gpioa = {0};
+GPIO_TypeDef    host_gpiob = {0};
+I2C_TypeDef     host_i2c1 = {0};
+uint32_t        SystemCoreClock = 160000000;
+
+static struct timespec  boot_time;
+static volatile bool    irq_enabled[HOST_IRQ_COUNT] = {false};
+static volatile bool    is_initialized = false;
+
+// Simulated MCP9808 state. The sensors share the ALERT line,
+// which is open drain, so any one of them can assert it
+static struct {
+    uint8_t             sensor_count;
+    uint64_t            present_us;
+    double              base_temp;
+    double              swing_temp;
+    double              period_s;
+    volatile bool       alert_asserted;
+} sim;
+
+static SimSensor        sim_sensors[HOST_MCP9808_MAX_SENSORS];
+
+// The interrupt-driven I2C transfer in progress, if any. The simulated
+// sensor acts on the transfer at once; the completion interrupt is
+// raised from the tick hook once the bus time has passed. An aborted
+// transfer holds the handle until its abort completes, as the real
+// HAL's does
+static struct {
+    I2C_HandleTypeDef* volatile handle;
+    volatile bool       is_read;
+    volatile bool       is_mem;
+    volatile bool       is_error;
+    volatile bool       is_aborted;
+    volatile uint64_t   complete_us;
+} sim_transfer;
+
+// Counters reported at exit
+static struct {
+    volatile uint32_t   led_writes;
+    volatile uint32_t   i2c_transactions;
+    volatile uint32_t   i2c_bytes;
+    volatile uint32_t   i2c_errors;
+    volatile uint32_t   alerts;
+} stats;
+
+
+/**
+ * @brief Stand-in for `HAL_Init()`: record the boot time, set up
+ *        the simulated sensor and, if `HOST_RUN_SECONDS` is set,
+ *        arm a thread which ends the run after that many seconds.
+ */
+HAL_StatusTypeDef HAL_Init(void) {
+
+    clock_gettime(CLOCK_MONOTONIC, &boot_time);
+    sim_init();
+    atexit(print_stats);
+
+    const char* run_seconds = getenv("HOST_RUN_SECONDS");
+    if (run_seconds != NULL && atoi(run_seconds) > 0) {
+        // Block all signals in the new thread so the POSIX port's
+        // tick signal is only ever taken by a FreeRTOS task thread
+        sigset_t all_signals, old_signals;
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+
+        pthread_t thread;
+        pthread_create(&thread, NULL, run_limit_thread, (void*)(intptr_t)atoi(run_seconds));
+        pthread_detach(thread);
+        pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    }
+
+    is_initialized = true;
+    return HAL_OK;
+}
+
+
+/**
+ * @brief Stand-in for the TIM6 timebase set-up. The host tick is
+ *        read from the monotonic clock, so there's nothing to start.
+ */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority) {
+
+    UNUSED(TickPriority);
+    return HAL_OK;
+}
+
+
+void HAL_IncTick(void) {
+
+    // NOP -- `HAL_GetTick()` reads the monotonic clock
+}
+
+
+uint32_t HAL_GetTick(void) {
+
+    return (uint32_t)(host_elapsed_us() / 1000);
+}
+
+
+/**
+ * @brief Stand-in for `HAL_Delay()`. Like the real thing, this holds
+ *        the calling task for the whole period.
+ */
+void HAL_Delay(uint32_t Delay) {
+
+    const uint64_t until = host_elapsed_us() + (uint64_t)Delay * 1000;
+    uint64_t now;
+    while ((now = host_elapsed_us()) < until) {
+        const uint64_t remaining_us = until - now;
+        struct timespec pause = { .tv_sec = remaining_us / 1000000,
+                                  .tv_nsec = (remaining_us % 1000000) * 1000 };
+        // Interrupted by the port's tick signal -- go round again
+        nanosleep(&pause, NULL);
+    }
+}
+
+
+void HAL_SuspendTick(void) {
+
+    // NOP
+}
+
+
+void HAL_ResumeTick(void) {
+
+    // NOP
+}
+
+
+void SystemCoreClockUpdate(void) {
+
+    // NOP -- `SystemCoreClock` is fixed on the host
+}
+
+
+/**
+ * @brief Microseconds since `HAL_Init()`.
+ */
+uint64_t host_elapsed_us(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - boot_time.tv_sec) * 1000000
+         + (int64_t)(now.tv_nsec - boot_time.tv_nsec) / 1000;
+}
+
+
+/*
+ * NVIC
+ */
+void HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup) {
+
+    UNUSED(PriorityGroup);
+}
+
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+
+    UNUSED(IRQn);
+    UNUSED(PreemptPriority);
+    UNUSED(SubPriority);
+}
+
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+
+    if (IRQn < HOST_IRQ_COUNT) irq_enabled[IRQn] = true;
+}
+
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+
+    if (IRQn < HOST_IRQ_COUNT) irq_enabled[IRQn] = false;
+}
+
+
+/**
+ * @brief Weak defaults for the interrupt handlers the simulation raises.
+ */
+__attribute__((weak)) void EXTI11_IRQHandler(void) {
+
+    HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_11);
+}
+
+
+__attribute__((weak)) void I2C1_EV_IRQHandler(void) {
+
+    // NOP -- the application's handler passes its I2C handle to the HAL
+}
+
+
+__attribute__((weak)) void I2C1_ER_IRQHandler(void) {
+
+    // NOP
+}
+
+
+/**
+ * @brief Dispatch a simulated interrupt, as the NVIC would.
+ *        Must be called from interrupt context, ie. the tick hook.
+ *
+ * @param irq: The interrupt to raise.
+ */
+void host_raise_irq(IRQn_Type irq) {
+
+    if (irq >= HOST_IRQ_COUNT || !irq_enabled[irq]) return;
+
+    switch (irq) {
+        case EXTI11_IRQn:
+            EXTI11_IRQHandler();
+            break;
+        case I2C1_EV_IRQn:
+            I2C1_EV_IRQHandler();
+            break;
+        case I2C1_ER_IRQn:
+            I2C1_ER_IRQHandler();
+            break;
+        default:
+            break;
+    }
+}
+
+
+/*
+ * RCC
+ */
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef* PeriphClkInit) {
+
+    UNUSED(PeriphClkInit);
+    return HAL_OK;
+}
+
+
+/*
+ * GPIO
+ */
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init) {
+
+    // Inputs idle high: the MCP9808 alert line has an external pull-up
+    if (GPIOx == GPIOB) GPIOx->IDR |= GPIO_Init->Pin;
+}
+
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+
+    if (PinState == GPIO_PIN_SET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+
+    stats.led_writes++;
+}
+
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+
+    GPIOx->ODR ^= GPIO_Pin;
+    stats.led_writes++;
+}
+
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin) {
+
+    HAL_GPIO_EXTI_Falling_Callback(GPIO_Pin);
+}
+
+
+__attribute__((weak)) void HAL_GPIO_EXTI_Falling_Callback(uint16_t GPIO_Pin) {
+
+    UNUSED(GPIO_Pin);
+}
+
+
+/*
+ * I2C
+ */
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c) {
+
+    HAL_I2C_MspInit(hi2c);
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+
+__attribute__((weak)) void HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+/**
+ * @brief Stand-in for `HAL_I2C_DeInit()`: drop any transfer in progress.
+ */
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c) {
+
+    if (sim_transfer.handle == hi2c) sim_transfer.handle = NULL;
+    return HAL_OK;
+}
+
+
+/**
+ * @brief Write to the simulated MCP9808, holding the caller for the bus time.
+ */
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+
+    UNUSED(Timeout);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    sim_bus_time(Size);
+    return sim_write(hi2c, DevAddress, pData, Size);
+}
+
+
+/**
+ * @brief Read from the simulated MCP9808, holding the caller for the bus time.
+ */
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+
+    UNUSED(Timeout);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    sim_bus_time(Size);
+    return sim_read(hi2c, DevAddress, pData, Size);
+}
+
+
+/**
+ * @brief Start an interrupt-driven write to the simulated MCP9808.
+ *        The transfer completes, with a call to `HAL_I2C_MasterTxCpltCallback()`
+ *        or `HAL_I2C_ErrorCallback()`, from the first tick after its bus time.
+ */
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t XferOptions) {
+
+    UNUSED(XferOptions);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    return sim_start_transfer(hi2c, sim_write(hi2c, DevAddress, pData, Size), false, false, Size);
+}
+
+
+/**
+ * @brief Start an interrupt-driven read from the simulated MCP9808.
+ *        The transfer completes, with a call to `HAL_I2C_MasterRxCpltCallback()`
+ *        or `HAL_I2C_ErrorCallback()`, from the first tick after its bus time.
+ */
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t XferOptions) {
+
+    UNUSED(XferOptions);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    return sim_start_transfer(hi2c, sim_read(hi2c, DevAddress, pData, Size), true, false, Size);
+}
+
+
+/**
+ * @brief Write to a register of the simulated MCP9808, holding the caller
+ *        for the bus time: the register address then the data, in one frame.
+ */
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+
+    UNUSED(MemAddSize);
+    UNUSED(Timeout);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    sim_bus_time(Size + 1);
+    return sim_mem_write(hi2c, DevAddress, MemAddress, pData, Size);
+}
+
+
+/**
+ * @brief Read a register of the simulated MCP9808, holding the caller for
+ *        the bus time: the register address, a repeated START, then the data.
+ */
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+
+    UNUSED(MemAddSize);
+    UNUSED(Timeout);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    sim_bus_time(Size + 2);
+    return sim_mem_read(hi2c, DevAddress, MemAddress, pData, Size);
+}
+
+
+/**
+ * @brief Start an interrupt-driven register write to the simulated MCP9808.
+ *        The transfer completes, with a call to `HAL_I2C_MemTxCpltCallback()`
+ *        or `HAL_I2C_ErrorCallback()`, from the first tick after its bus time.
+ */
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size) {
+
+    UNUSED(MemAddSize);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    return sim_start_transfer(hi2c, sim_mem_write(hi2c, DevAddress, MemAddress, pData, Size), false, true, Size + 1);
+}
+
+
+/**
+ * @brief Start an interrupt-driven register read from the simulated MCP9808.
+ *        The transfer completes, with a call to `HAL_I2C_MemRxCpltCallback()`
+ *        or `HAL_I2C_ErrorCallback()`, from the first tick after its bus time.
+ */
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size) {
+
+    UNUSED(MemAddSize);
+    if (sim_transfer.handle != NULL) return HAL_BUSY;
+    return sim_start_transfer(hi2c, sim_mem_read(hi2c, DevAddress, MemAddress, pData, Size), true, true, Size + 2);
+}
+
+
+/**
+ * @brief Abort an interrupt-driven transfer. As with the real HAL, only
+ *        plain master transfers can be aborted, not register transfers,
+ *        and the abort completes later, with a call to
+ *        `HAL_I2C_AbortCpltCallback()` from the next tick.
+ */
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress) {
+
+    UNUSED(DevAddress);
+    if (sim_transfer.handle != hi2c || sim_transfer.is_mem || sim_transfer.is_aborted) return HAL_ERROR;
+    sim_transfer.is_aborted = true;
+    sim_transfer.complete_us = host_elapsed_us();
+    return HAL_OK;
+}
+
+
+/**
+ * @brief Complete a successful or aborted interrupt-driven transfer.
+ */
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef* hi2c) {
+
+    if (sim_transfer.handle != hi2c) return;
+    if (sim_transfer.is_aborted) {
+        sim_transfer.handle = NULL;
+        HAL_I2C_AbortCpltCallback(hi2c);
+        return;
+    }
+    if (sim_transfer.is_error) return;
+
+    sim_transfer.handle = NULL;
+    if (sim_transfer.is_mem) {
+        if (sim_transfer.is_read) {
+            HAL_I2C_MemRxCpltCallback(hi2c);
+        } else {
+            HAL_I2C_MemTxCpltCallback(hi2c);
+        }
+    } else if (sim_transfer.is_read) {
+        HAL_I2C_MasterRxCpltCallback(hi2c);
+    } else {
+        HAL_I2C_MasterTxCpltCallback(hi2c);
+    }
+}
+
+
+/**
+ * @brief Complete a failed interrupt-driven transfer.
+ */
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef* hi2c) {
+
+    if (sim_transfer.handle != hi2c || !sim_transfer.is_error || sim_transfer.is_aborted) return;
+
+    sim_transfer.handle = NULL;
+    HAL_I2C_ErrorCallback(hi2c);
+}
+
+
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+__attribute__((weak)) void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+__attribute__((weak)) void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef* hi2c) {
+
+    UNUSED(hi2c);
+}
+
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout) {
+
+    UNUSED(Trials);
+    UNUSED(Timeout);
+    sim_bus_time(0);
+    stats.i2c_transactions++;
+
+    if (sim_addressed(DevAddress) == NULL) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        stats.i2c_errors++;
+        return HAL_ERROR;
+    }
+
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef* hi2c) {
+
+    return hi2c->ErrorCode;
+}
+
+
+/*
+ * FREERTOS HOOKS
+ */
+
+/**
+ * @brief Drive the simulated MCP9808 ALERT line, and complete interrupt-driven
+ *        I2C transfers, from the tick interrupt.
+ *        The sensor runs in comparator mode, so the line asserts (falls)
+ *        when the temperature leaves the window set by the limit registers,
+ *        and releases once it is back inside.
+ */
+void vApplicationTickHook(void) {
+
+    if (!is_initialized) return;
+
+    // Raise the completion interrupt for a transfer whose bus time is up
+    if (sim_transfer.handle != NULL && host_elapsed_us() >= sim_transfer.complete_us) {
+        host_raise_irq(sim_transfer.is_error && !sim_transfer.is_aborted ? I2C1_ER_IRQn : I2C1_EV_IRQn);
+    }
+
+    bool should_assert = false;
+    for (uint8_t i = 0 ; i < sim.sensor_count ; ++i) {
+        if (sim_alert_condition(&sim_sensors[i])) should_assert = true;
+    }
+
+    if (should_assert && !sim.alert_asserted) {
+        sim.alert_asserted = true;
+        GPIOB->IDR &= ~(uint32_t)GPIO_PIN_11;
+        stats.alerts++;
+        host_raise_irq(EXTI11_IRQn);
+    } else if (!should_assert && sim.alert_asserted) {
+        sim.alert_asserted = false;
+        GPIOB->IDR |= GPIO_PIN_11;
+    }
+}
+
+
+/**
+ * @brief Report a failed `configASSERT()` and stop.
+ */
+void host_assert_failed(const char* file, int line) {
+
+    fprintf(stderr, "configASSERT() failed at %s:%i\n", file, line);
+    abort();
+}
+
+
+/*
+ * SIMULATION
+ */
+
+/**
+ * @brief Set up the simulated sensors from the environment:
+ *          HOST_SENSOR_COUNT   Number of sensors, from HOST_MCP9808_ADDR up, default 1
+ *          HOST_TEMP_C         Mean temperature, default 22.0
+ *          HOST_TEMP_SWING_C   Amplitude of a sinusoidal swing, default 0.0
+ *          HOST_TEMP_PERIOD_S  Period of the swing, default 120
+ *          HOST_NO_SENSOR      Set to simulate a missing sensor
+ *          HOST_SENSOR_DELAY_S Seconds before the sensors respond, default 0,
+ *                              eg. to simulate sensors plugged in later
+ *        Each sensor after the first reads HOST_SENSOR_STEP_C warmer
+ *        than the one before.
+ */
+static void sim_init(void) {
+
+    const char* value;
+    const int count = (value = getenv("HOST_SENSOR_COUNT")) ? atoi(value) : 1;
+    sim.sensor_count = (uint8_t)(count < 0 ? 0 : (count > HOST_MCP9808_MAX_SENSORS ? HOST_MCP9808_MAX_SENSORS : count));
+    if (getenv("HOST_NO_SENSOR") != NULL) sim.sensor_count = 0;
+    sim.present_us = (value = getenv("HOST_SENSOR_DELAY_S")) ? (uint64_t)(atof(value) * 1000000.0) : 0;
+    sim.base_temp  = (value = getenv("HOST_TEMP_C")) ? atof(value) : 22.0;
+    sim.swing_temp = (value = getenv("HOST_TEMP_SWING_C")) ? atof(value) : 0.0;
+    sim.period_s   = (value = getenv("HOST_TEMP_PERIOD_S")) ? atof(value) : 120.0;
+    if (sim.period_s <= 0.0) sim.period_s = 120.0;
+
+    for (uint8_t i = 0 ; i < HOST_MCP9808_MAX_SENSORS ; ++i) {
+        SimSensor* sensor = &sim_sensors[i];
+        memset((void*)sensor->regs, 0, sizeof(sensor->regs));
+        sensor->regs[0x06] = HOST_MCP9808_MANUF_ID;
+        sensor->regs[0x07] = HOST_MCP9808_DEVICE_ID;
+        sensor->regs[0x08] = 0x03;
+        sensor->pointer = 0x05;
+        sensor->offset_temp = i * HOST_SENSOR_STEP_C;
+    }
+}
+
+
+static double sim_temp_now(const SimSensor* sensor) {
+
+    const double t = (double)host_elapsed_us() / 1000000.0;
+    return sim.base_temp + sensor->offset_temp + sim.swing_temp * sin(2.0 * M_PI * t / sim.period_s);
+}
+
+
+/**
+ * @brief The temperature from the last completed conversion. Like the real
+ *        sensor, the simulation converts back to back, at the conversion
+ *        time for the resolution set in register 0x08.
+ */
+static double sim_converted_temp(const SimSensor* sensor) {
+
+    static const uint64_t conversion_us[4] = { 30000, 65000, 130000, 250000 };
+    const uint64_t period_us = conversion_us[sensor->regs[0x08] & 0x03];
+    const double t = (double)((host_elapsed_us() / period_us) * period_us) / 1000000.0;
+    return sim.base_temp + sensor->offset_temp + sim.swing_temp * sin(2.0 * M_PI * t / sim.period_s);
+}
+
+
+/**
+ * @brief Encode a temperature as the MCP9808 ambient register does:
+ *        13-bit two's complement in 1/16°C, plus the three limit flags.
+ */
+static uint16_t sim_encode_temp(const SimSensor* sensor, double temp) {
+
+    // Bits below the resolution read as zero
+    const uint16_t resolution_mask = (uint16_t)~((1u << (3 - (sensor->regs[0x08] & 0x03))) - 1);
+    uint16_t value = (uint16_t)((int16_t)lround(temp * 16.0)) & 0x1FFF & resolution_mask;
+    if (temp >= sim_decode_limit(sensor->regs[0x04])) value |= 0x8000;
+    if (temp >  sim_decode_limit(sensor->regs[0x02])) value |= 0x4000;
+    if (temp <  sim_decode_limit(sensor->regs[0x03])) value |= 0x2000;
+    return value;
+}
+
+
+static double sim_decode_limit(uint16_t value) {
+
+    int16_t signed_value = (int16_t)(value << 3) >> 3;
+    return (double)signed_value / 16.0;
+}
+
+
+static bool sim_alert_condition(const SimSensor* sensor) {
+
+    // CONFIG bit 3 enables the ALERT output
+    if ((sensor->regs[0x01] & 0x0008) == 0) return false;
+
+    const double temp = sim_temp_now(sensor);
+    return (temp >  sim_decode_limit(sensor->regs[0x02]) ||
+            temp <  sim_decode_limit(sensor->regs[0x03]) ||
+            temp >= sim_decode_limit(sensor->regs[0x04]));
+}
+
+
+/**
+ * @brief Find the simulated sensor at an 8-bit bus address.
+ *
+ * @returns The sensor, or `NULL` if none answers at the address.
+ */
+static SimSensor* sim_addressed(uint16_t dev_address) {
+
+    const uint16_t address = dev_address >> 1;
+    if (host_elapsed_us() < sim.present_us) return NULL;
+    if (address < HOST_MCP9808_ADDR || address >= HOST_MCP9808_ADDR + sim.sensor_count) return NULL;
+    return &sim_sensors[address - HOST_MCP9808_ADDR];
+}
+
+
+/**
+ * @brief Write to the simulated MCP9808: the first byte sets the register
+ *        pointer, any further bytes are written to that register.
+ */
+static HAL_StatusTypeDef sim_write(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint8_t* data, uint16_t size) {
+
+    stats.i2c_transactions++;
+
+    SimSensor* sensor = sim_addressed(dev_address);
+    if (sensor == NULL || size == 0) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        stats.i2c_errors++;
+        return HAL_ERROR;
+    }
+
+    sensor->pointer = data[0] & 0x0F;
+    stats.i2c_bytes += size;
+
+    if (size > 1 && sensor->pointer < 9) {
+        uint16_t value = (size > 2) ? (uint16_t)((data[1] << 8) | data[2]) : data[1];
+        switch (sensor->pointer) {
+            case 0x01:
+                // The interrupt clear bit always reads back as zero
+                sensor->regs[0x01] = value & 0x07DF;
+                break;
+            case 0x02:
+            case 0x03:
+            case 0x04:
+                sensor->regs[sensor->pointer] = value & 0x1FFC;
+                break;
+            case 0x08:
+                sensor->regs[0x08] = value & 0x03;
+                break;
+            default:
+                // Read-only register
+                break;
+        }
+    }
+
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+
+/**
+ * @brief Read the register selected by the last write to the simulated MCP9808.
+ */
+static HAL_StatusTypeDef sim_read(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint8_t* data, uint16_t size) {
+
+    stats.i2c_transactions++;
+
+    const SimSensor* sensor = sim_addressed(dev_address);
+    if (sensor == NULL) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        stats.i2c_errors++;
+        return HAL_ERROR;
+    }
+
+    uint16_t value = 0;
+    if (sensor->pointer == 0x05) {
+        value = sim_encode_temp(sensor, sim_converted_temp(sensor));
+    } else if (sensor->pointer < 9) {
+        value = sensor->regs[sensor->pointer];
+    }
+
+    if (sensor->pointer == 0x08) {
+        // Resolution is an 8-bit register
+        if (size > 0) data[0] = (uint8_t)value;
+    } else {
+        if (size > 0) data[0] = (uint8_t)(value >> 8);
+        if (size > 1) data[1] = (uint8_t)(value & 0xFF);
+    }
+
+    stats.i2c_bytes += size;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+
+/**
+ * @brief Write to a register of the simulated MCP9808, as a single write
+ *        of the register address followed by the data.
+ */
+static HAL_StatusTypeDef sim_mem_write(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint16_t mem_address, uint8_t* data, uint16_t size) {
+
+    uint8_t frame[3] = { (uint8_t)mem_address, 0, 0 };
+    if (size > 2) size = 2;
+    memcpy(&frame[1], data, size);
+    return sim_write(hi2c, dev_address, frame, size + 1);
+}
+
+
+/**
+ * @brief Read a register of the simulated MCP9808. The register address
+ *        write and the read count as one transaction.
+ */
+static HAL_StatusTypeDef sim_mem_read(I2C_HandleTypeDef* hi2c, uint16_t dev_address, uint16_t mem_address, uint8_t* data, uint16_t size) {
+
+    SimSensor* sensor = sim_addressed(dev_address);
+    if (sensor != NULL) {
+        sensor->pointer = mem_address & 0x0F;
+        stats.i2c_bytes++;
+    }
+
+    return sim_read(hi2c, dev_address, data, size);
+}
+
+
+/**
+ * @brief Queue the completion interrupt for an interrupt-driven transfer.
+ *        Like the real peripheral, a NACK is reported by the error
+ *        interrupt, not by the call which starts the transfer.
+ *
+ * @param result:  The outcome of the simulated transfer.
+ * @param is_read: `true` for a read, `false` for a write.
+ * @param is_mem:  `true` for a register transfer.
+ * @param bytes:   The number of bytes on the bus, excluding the first address byte.
+ */
+static HAL_StatusTypeDef sim_start_transfer(I2C_HandleTypeDef* hi2c, HAL_StatusTypeDef result, bool is_read, bool is_mem, uint16_t bytes) {
+
+    sim_transfer.is_read = is_read;
+    sim_transfer.is_mem = is_mem;
+    sim_transfer.is_error = (result != HAL_OK);
+    sim_transfer.is_aborted = false;
+    sim_transfer.complete_us = host_elapsed_us() + sim_bus_time_us(bytes);
+    sim_transfer.handle = hi2c;
+    return HAL_OK;
+}
+
+
+/**
+ * @brief The time a transfer occupies the bus.
+ *
+ * @param bytes: The number of data bytes, excluding the address byte.
+ */
+static uint64_t sim_bus_time_us(uint16_t bytes) {
+
+    return ((uint64_t)(bytes + 1) * HOST_I2C_NS_PER_BYTE) / 1000;
+}
+
+
+/**
+ * @brief Hold the caller for as long as the transfer would occupy the bus,
+ *        as the blocking HAL calls poll the peripheral until it's done.
+ *
+ * @param bytes: The number of data bytes, excluding the address byte.
+ */
+static void sim_bus_time(uint16_t bytes) {
+
+    const uint64_t until = host_elapsed_us() + sim_bus_time_us(bytes);
+    while (host_elapsed_us() < until) {
+        // Spin
+    }
+}
+
+
+/**
+ * @brief End the run after the requested number of seconds.
+ */
+static void *run_limit_thread(void *argument) {
+
+    const unsigned int seconds = (unsigned int)(intptr_t)argument;
+    struct timespec pause = { .tv_sec = seconds, .tv_nsec = 0 };
+    while (nanosleep(&pause, &pause) != 0 && errno == EINTR) {
+        // Keep sleeping
+    }
+
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
+    return NULL;
+}
+
+
+static void print_stats(void) {
+
+    fprintf(stderr, "[HOST] Run time:         %.3f s\n", (double)host_elapsed_us() / 1000000.0);
+    fprintf(stderr, "[HOST] LED writes:       %u\n", stats.led_writes);
+    fprintf(stderr, "[HOST] I2C transactions: %u (%u bytes, %u errors)\n", stats.i2c_transactions, stats.i2c_bytes, stats.i2c_errors);
+    fprintf(stderr, "[HOST] Sensor alerts:    %u\n", stats.alerts);
+}
@@ -0,0 +1,106 @@
+/**
+ *
+ * Microvisor Native FreeRTOS Demo
+ * Host stand-ins for the Microvisor system calls
+ *
+ * Copyright © 2024, KORE Wireless
+ * Licence: MIT
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+// Host
+#include "mv_syscalls.h"
+#include "host_sim.h"
+
+
+/*
+ * STATIC PROTOTYPES
+ */
+static void print_stats(void);
+
+
+/*
+ * GLOBALS
+ */
+static bool logging_started = false;
+
+// Counters reported at exit
+static struct {
+    volatile uint32_t   log_calls;
+    volatile uint32_t   log_bytes;
+} stats;
+
+
+/**
+ * @brief Start logging. The host writes log output to stdout, so
+ *        the buffer is only checked, not used.
+ */
+enum MvStatus mvServerLoggingInit(uint8_t* buffer, uint32_t length) {
+
+    if (buffer == NULL || length == 0) return MV_STATUS_PARAMETERFAULT;
+
+    if (!logging_started) {
+        logging_started = true;
+        atexit(print_stats);
+    }
+
+    return MV_STATUS_OKAY;
+}
+
+
+/**
+ * @brief Post a log message: print it to stdout with a timestamp.
+ */
+enum MvStatus mvServerLog(const uint8_t* text, uint16_t length) {
+
+    if (!logging_started) return MV_STATUS_LOGGINGNOTSTARTED;
+    if (text == NULL) return MV_STATUS_PARAMETERFAULT;
+
+    const uint64_t now_us = host_elapsed_us();
+    printf("[%6llu.%03llu] %.*s\n",
+           (unsigned long long)(now_us / 1000000),
+           (unsigned long long)((now_us / 1000) % 1000),
+           (int)length, (const char*)text);
+    fflush(stdout);
+
+    stats.log_calls++;
+    stats.log_bytes += length;
+    return MV_STATUS_OKAY;
+}
+
+
+enum MvStatus mvGetHClk(uint32_t* hclk) {
+
+    if (hclk == NULL) return MV_STATUS_PARAMETERFAULT;
+    *hclk = 160000000;
+    return MV_STATUS_OKAY;
+}
+
+
+enum MvStatus mvGetPClk1(uint32_t* pclk1) {
+
+    if (pclk1 == NULL) return MV_STATUS_PARAMETERFAULT;
+    *pclk1 = 160000000;
+    return MV_STATUS_OKAY;
+}
+
+
+/**
+ * @brief Report a device ID in the Microvisor format: 'UV' plus 32 hex digits.
+ */
+enum MvStatus mvGetDeviceId(uint8_t* buffer, uint32_t length) {
+
+    static const char host_id[] = "UV00000000000000000000000000000000";
+    if (buffer == NULL || length < sizeof(host_id) - 1) return MV_STATUS_PARAMETERFAULT;
+    memcpy(buffer, host_id, sizeof(host_id) - 1);
+    return MV_STATUS_OKAY;
+}
+
+
+static void print_stats(void) {
+
+    fprintf(stderr, "[HOST] mvServerLog():    %u calls, %u bytes\n", stats.log_calls, stats.log_bytes);
+}
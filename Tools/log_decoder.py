@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""
+Microvisor Native FreeRTOS Demo
+
+Decode tokenized log output, ie. from a build with LOG_TOKENIZED=1.
+
+Each tokenized message is logged as '$' followed by a Base64 frame: a flags
+byte, the format string's token as a zigzag varint, then the arguments. A
+string argument the firmware had to cut short is shown ending in '…'. The
+token is the format string's address relative to the `log_token_base` symbol,
+so the format strings are read back from the firmware ELF. Lines which hold
+no frame are passed through unchanged.
+
+Usage:
+    twilio microvisor:deploy . --devicesid ${MV_DEVICE_SID} --logonly | \\
+        python3 Tools/log_decoder.py build/Demo/native_freertos_demo.elf
+
+Copyright © 2024, KORE Wireless
+Licence: MIT
+"""
+import argparse
+import base64
+import binascii
+import re
+import struct
+import sys
+
+FRAME_PATTERN = re.compile(r"\$([A-Za-z0-9+/]+={0,2})")
+FORMAT_PATTERN = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGaAp%])")
+
+LOG_FLAG_ERROR = 0x01
+LOG_TOKEN_STRING_TRUNCATED = 0x80
+LOG_FLAG_SUPPRESSED = 0x02
+TOKEN_BASE_SYMBOL = "log_token_base"
+
+
+class Elf:
+    """Just enough of an ELF reader to find symbols and read constant data."""
+
+    def __init__(self, path):
+        with open(path, "rb") as file:
+            self.data = file.read()
+
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError(f"{path} is not an ELF file")
+
+        self.is_64 = self.data[4] == 2
+        self.endian = "<" if self.data[5] == 1 else ">"
+        self.word_bits = 64 if self.is_64 else 32
+        self.sections = self._read_sections()
+
+    def _unpack(self, fmt, offset):
+        return struct.unpack_from(self.endian + fmt, self.data, offset)
+
+    def _read_sections(self):
+        if self.is_64:
+            sh_off, = self._unpack("Q", 0x28)
+            sh_entsize, sh_num = self._unpack("HH", 0x3A)
+            fmt = "IIQQQQIIQQ"
+        else:
+            sh_off, = self._unpack("I", 0x20)
+            sh_entsize, sh_num = self._unpack("HH", 0x2E)
+            fmt = "IIIIIIIIII"
+
+        sections = []
+        for index in range(sh_num):
+            (name, kind, flags, addr, offset, size,
+             link, _, _, entsize) = self._unpack(fmt, sh_off + index * sh_entsize)
+            sections.append({"type": kind, "flags": flags, "addr": addr, "offset": offset,
+                             "size": size, "link": link, "entsize": entsize})
+        return sections
+
+    def symbol(self, wanted):
+        """Return the address of the named symbol."""
+        for section in self.sections:
+            if section["type"] != 2:  # SHT_SYMTAB
+                continue
+
+            strings = self.sections[section["link"]]
+            for offset in range(section["offset"], section["offset"] + section["size"], section["entsize"]):
+                if self.is_64:
+                    name, _, _, _, value, _ = self._unpack("IBBHQQ", offset)
+                else:
+                    name, value, _, _, _, _ = self._unpack("IIIBBH", offset)
+                start = strings["offset"] + name
+                end = self.data.index(b"\0", start)
+                if self.data[start:end].decode("ascii", "replace") == wanted:
+                    return value
+
+        raise KeyError(f"symbol {wanted} not found -- was the firmware built with LOG_TOKENIZED=1?")
+
+    def string_at(self, address):
+        """Return the NUL-terminated string at the given address."""
+        for section in self.sections:
+            # Allocated sections with contents in the file
+            if section["flags"] & 0x2 and section["type"] != 8 and \
+               section["addr"] <= address < section["addr"] + section["size"]:
+                start = section["offset"] + address - section["addr"]
+                end = self.data.index(b"\0", start)
+                return self.data[start:end].decode("utf-8", "replace")
+
+        raise KeyError(f"no string at 0x{address:08x}")
+
+
+class Frame:
+    """Cursor over a decoded binary frame."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def varint(self):
+        result = shift = 0
+        while True:
+            byte = self.byte()
+            result |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        # Undo the zigzag encoding
+        return (result >> 1) ^ -(result & 1)
+
+    def float32(self):
+        value, = struct.unpack_from("<f", self.data, self.pos)
+        self.pos += 4
+        return value
+
+    def string(self):
+        length = self.byte()
+        truncated = length & LOG_TOKEN_STRING_TRUNCATED
+        length &= ~LOG_TOKEN_STRING_TRUNCATED
+        value = self.data[self.pos:self.pos + length].decode("utf-8", "replace")
+        self.pos += length
+        return value + "…" if truncated else value
+
+
+def format_message(format_string, frame, word_bits):
+    """Rebuild the text of a message from its format string and arguments."""
+
+    def convert(match):
+        flags, width, precision, length, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+
+        if conversion in "fFeEgGaA":
+            value = frame.float32()
+            if conversion in "aA":
+                conversion = "e"
+        elif conversion == "s":
+            value = frame.string()
+        else:
+            value = frame.varint()
+            if conversion in "ouxXp":
+                bits = 64 if length in ("ll", "j") or (length in ("l", "z", "t") and word_bits == 64) else 32
+                value &= (1 << bits) - 1
+            if conversion == "c":
+                value = chr(value & 0xFF)
+            elif conversion in "iu":
+                conversion = "d"
+            elif conversion == "p":
+                conversion, flags = "x", "#"
+
+        spec = "%" + (flags or "") + (width or "") + ("." + precision if precision is not None else "") + conversion
+        return spec % value
+
+    return FORMAT_PATTERN.sub(convert, format_string)
+
+
+def decode_frame(text, elf, token_base):
+    frame = Frame(base64.b64decode(text))
+    flags = frame.byte()
+    format_string = elf.string_at(token_base + frame.varint())
+    message = format_message(format_string, frame, elf.word_bits)
+    if flags & LOG_FLAG_SUPPRESSED:
+        message += f" [{frame.varint()} suppressed]"
+    return ("[ERROR] " if flags & LOG_FLAG_ERROR else "[DEBUG] ") + message
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode tokenized log output")
+    parser.add_argument("elf", help="the firmware ELF file")
+    parser.add_argument("log", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="the log output to decode (default: stdin)")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    token_base = elf.symbol(TOKEN_BASE_SYMBOL)
+
+    def replace(match):
+        try:
+            return decode_frame(match.group(1), elf, token_base)
+        except (KeyError, IndexError, struct.error, binascii.Error, TypeError, ValueError) as error:
+            return f"{match.group(0)} <undecodable: {error}>"
+
+    for line in args.log:
+        sys.stdout.write(FRAME_PATTERN.sub(replace, line))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+Microvisor Native FreeRTOS Demo
+
+Work out the worst-case stack use of each task, and recommend stack sizes.
+
+The build compiles with `-fstack-usage`, so GCC writes a `.su` file next to
+each object file, giving every function's frame size. The call graph comes
+from disassembling the firmware ELF with objdump. Each task's worst case is
+the deepest path from its entry function, plus the context the port and the
+core save on the task's stack. Functions called through pointers, recursion
+and frames which grow at run time can't be followed, and are listed.
+
+Pass the device log to compare the worst cases with the high-water marks
+that `stack_log_stats()` logs. The recommended size covers the larger of
+the two, plus a margin.
+
+Usage:
+    python3 Tools/stack_usage.py build
+    python3 Tools/stack_usage.py build --log device.log
+
+Copyright © 2024, KORE Wireless
+Licence: MIT
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+DEFAULT_ELF = os.path.join("Demo", "native_freertos_demo.elf")
+
+# Each task's entry function, and functions called through pointers from
+# it, eg. timer callbacks
+TASKS = {
+    "LED_TASK": ("task_led", []),
+    "WORK_TASK": ("task_sensor", []),
+    "ALERT_TASK": ("task_alert", []),
+    "LOG_TASK": ("task_log", []),
+    "I2C_TASK": ("task_i2c", []),
+    "IDLE": ("prvIdleTask", ["vPortSuppressTicksAndSleep"]),
+    "Tmr Svc": ("prvTimerTask", ["alert_timer_fired"]),
+}
+
+# The Cortex-M33 stacks eight words on exception entry, and the FreeRTOS
+# port saves eleven more when it switches tasks
+CONTEXT_BYTES = 19 * 4
+
+FUNCTION_PATTERN = re.compile(r"^[0-9a-f]+ <([^>]+)>:$")
+CALL_PATTERN = re.compile(r"\s(bl|blx|b|b\.w|b\.n|call|callq|jmp|jmpq)\s+[0-9a-f]+ <([^+>]+)>")
+INDIRECT_PATTERN = re.compile(r"\s(blx\s+r\d+|call\s+\*|callq\s+\*)")
+STACK_LOG_PATTERN = re.compile(r"Stack (.+?): (\d+) of (\d+) words used")
+
+
+def read_frames(build_dir):
+    """Read every function's frame size, and its qualifiers, from the .su files."""
+    frames = {}
+    for root, _, files in os.walk(build_dir):
+        for name in files:
+            if not name.endswith(".su"):
+                continue
+            with open(os.path.join(root, name)) as file:
+                for line in file:
+                    fields = line.rstrip("\n").split("\t")
+                    if len(fields) < 3:
+                        continue
+                    function = fields[0].rsplit(":", 1)[-1]
+                    size = int(fields[1])
+                    if function not in frames or size > frames[function][0]:
+                        frames[function] = (size, fields[2])
+    return frames
+
+
+def read_call_graph(elf, objdump):
+    """Disassemble the ELF and list the functions each function calls."""
+    output = subprocess.run([objdump, "-d", "--no-show-raw-insn", elf],
+                            check=True, capture_output=True, text=True).stdout
+    calls = {}
+    indirect = set()
+    function = None
+    for line in output.splitlines():
+        match = FUNCTION_PATTERN.match(line)
+        if match:
+            function = match.group(1)
+            calls.setdefault(function, set())
+            continue
+        if function is None:
+            continue
+        match = CALL_PATTERN.search(line)
+        if match and match.group(2) != function:
+            calls[function].add(match.group(2))
+        elif INDIRECT_PATTERN.search(line):
+            indirect.add(function)
+    return calls, indirect
+
+
+class Analysis:
+    """Worst-case stack depth through the call graph, noting what can't be followed."""
+
+    def __init__(self, frames, calls, indirect):
+        self.frames = frames
+        self.calls = calls
+        self.indirect = indirect
+        self.depths = {}
+        self.notes = {}
+
+    def depth(self, function, path=()):
+        if function in path:
+            self.notes.setdefault("recursion", set()).add(function)
+            return 0
+        if function in self.depths:
+            return self.depths[function]
+
+        size, qualifiers = self.frames.get(function, (0, "static"))
+        if function not in self.frames:
+            self.notes.setdefault("no frame size", set()).add(function)
+        elif "dynamic" in qualifiers and "bounded" not in qualifiers:
+            self.notes.setdefault("frames which grow at run time", set()).add(function)
+        if function in self.indirect:
+            self.notes.setdefault("calls through pointers", set()).add(function)
+
+        deepest = max((self.depth(callee, path + (function,)) for callee in self.calls.get(function, ())), default=0)
+        self.depths[function] = size + deepest
+        return size + deepest
+
+
+def read_stack_log(path):
+    """Read the latest words used, and the stack depth, of each task from the log."""
+    used = {}
+    with open(path, errors="replace") as file:
+        for line in file:
+            match = STACK_LOG_PATTERN.search(line)
+            if match:
+                used[match.group(1)] = (int(match.group(2)), int(match.group(3)))
+    return used
+
+
+def recommend(words, margin, round_words):
+    words = -(-words * (100 + margin) // 100)
+    return -(-words // round_words) * round_words
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Work out each task's worst-case stack use")
+    parser.add_argument("build", help="the build directory, which holds the .su files")
+    parser.add_argument("--elf", help=f"the firmware ELF file (default: BUILD/{DEFAULT_ELF})")
+    parser.add_argument("--log", help="device log output holding 'Stack ...' lines")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump", help="the objdump to use")
+    parser.add_argument("--margin", type=int, default=25, help="the margin to add, in percent (default: 25)")
+    parser.add_argument("--round", type=int, default=32, help="round sizes up to this many words (default: 32)")
+    args = parser.parse_args()
+
+    frames = read_frames(args.build)
+    if not frames:
+        sys.exit(f"No .su files found in {args.build}: build with -fstack-usage")
+
+    calls, indirect = read_call_graph(args.elf or os.path.join(args.build, DEFAULT_ELF), args.objdump)
+    analysis = Analysis(frames, calls, indirect)
+    measured = read_stack_log(args.log) if args.log else {}
+
+    print(f"{'Task':<12}{'Entry':<16}{'Static':>8}{'Used':>8}{'Depth':>8}{'Recommend':>11}  (words)")
+    allocated = total = 0
+    for task, (entry, callbacks) in TASKS.items():
+        if entry not in calls:
+            print(f"{task:<12}{entry:<16}  not in the ELF")
+            continue
+
+        worst = analysis.depth(entry) + max((analysis.depth(callback) for callback in callbacks), default=0)
+        static_words = -(-(worst + CONTEXT_BYTES) // 4)
+        used_words, depth = measured.get(task, (0, 0))
+        size = recommend(max(static_words, used_words), args.margin, args.round)
+        print(f"{task:<12}{entry:<16}{static_words:>8}{used_words if depth else '-':>8}"
+              f"{depth if depth else '-':>8}{size:>11}")
+
+        if depth:
+            allocated += depth
+            total += size
+
+    if allocated:
+        print(f"\nAllocated {allocated} words, recommended {total}: "
+              f"{(allocated - total) * 4} bytes could be freed")
+
+    for note, functions in sorted(analysis.notes.items()):
+        print(f"\nNot counted in full -- {note}:")
+        print("  " + ", ".join(sorted(functions)))
+
+
+if __name__ == "__main__":
+    main()
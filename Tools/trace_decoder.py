@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""
+Microvisor Native FreeRTOS Demo
+
+Turn a kernel trace dump, from a build with TRACE_RECORDER=1, into a timeline
+in the Chrome trace event format. Open it at https://ui.perfetto.dev or in
+chrome://tracing.
+
+The firmware logs a dump when an alert fires: a header line, a line naming
+each task, then the events as Base64 lines. Each event is eight bytes: a
+32-bit timestamp from the core's cycle counter, the event type, the task
+number and a 16-bit argument. The header gives the counter's rate, which
+converts the timestamps to microseconds. The counter wraps every 26s at
+160MHz: the decoder carries the timestamps over a wrap, which assumes no gap
+between events is longer than that. The LED task keeps events frequent.
+
+A notification records its sender, or task 0 from an interrupt. The task it
+wakes records a TASK_READY event right after it, which gives the target.
+The decoder also prints, for each notification sent from an
+interrupt, how long the notified task took to run and to receive it: the
+latency from `EXTI11_IRQHandler` to the alert task.
+
+Decode tokenized log output with `log_decoder.py` first.
+
+Usage:
+    python3 Tools/trace_decoder.py device.log -o trace.json
+
+Copyright © 2024, KORE Wireless
+Licence: MIT
+"""
+import argparse
+import base64
+import binascii
+import json
+import re
+import struct
+import sys
+
+DUMP_PATTERN = re.compile(r"Trace dump: (\d+) events(?:, \d+ overwritten, (\d+) cycles/us)?")
+TASK_PATTERN = re.compile(r"Trace task (\d+): (.+?)\s*$")
+DATA_PATTERN = re.compile(r"Trace data (\d+): ([A-Za-z0-9+/]+={0,2})")
+END_PATTERN = re.compile(r"Trace end")
+
+EVENT_FORMAT = "<IBBH"
+EVENT_SIZE = struct.calcsize(EVENT_FORMAT)
+
+# Event types: see `TRACE_EVENT_*` in `Config/trace_events.h`
+TASK_IN = 1
+TASK_OUT = 2
+NOTIFY = 3
+NOTIFY_FROM_ISR = 4
+NOTIFY_RECEIVED = 5
+TIMER_COMMAND = 6
+TIMER_EXPIRED = 7
+ISR_ENTER = 8
+ISR_EXIT = 9
+TRIGGER = 10
+TASK_READY = 11
+
+IRQ_NAMES = {22: "EXTI11", 55: "I2C1_EV", 56: "I2C1_ER"}
+TIMER_COMMANDS = {
+    0xFFFE: "execute callback from ISR", 0xFFFF: "execute callback",
+    0: "start (untraced)", 1: "start", 2: "reset", 3: "stop", 4: "change period", 5: "delete",
+    6: "start from ISR", 7: "reset from ISR", 8: "stop from ISR", 9: "change period from ISR",
+}
+
+# Interrupts are drawn on their own tracks, after the tasks'
+ISR_TRACK_BASE = 1000
+
+
+class Dump:
+    """One trace dump: the task names and the raw event data."""
+
+    def __init__(self, cycles_per_us):
+        self.cycles_per_us = cycles_per_us
+        self.tasks = {}
+        self.chunks = {}
+        self.complete = False
+
+    def events(self):
+        data = b"".join(chunk for _, chunk in sorted(self.chunks.items()))
+        usable = len(data) - len(data) % EVENT_SIZE
+        events = []
+        last = None
+        offset = 0
+        for cycles, kind, task, arg in struct.iter_unpack(EVENT_FORMAT, data[:usable]):
+            # Timestamps are 32-bit cycle counts: carry them over a wrap
+            if last is not None and cycles + offset < last:
+                offset += 1 << 32
+            last = cycles + offset
+            events.append((last / self.cycles_per_us, kind, task, arg))
+        return events
+
+
+def read_dumps(lines, cycles_per_us):
+    """Collect every dump in the log, complete or not."""
+    dumps = []
+    for line in lines:
+        match = DUMP_PATTERN.search(line)
+        if match:
+            dumps.append(Dump(int(match.group(2)) if match.group(2) else cycles_per_us))
+            continue
+        if not dumps or dumps[-1].complete:
+            continue
+
+        dump = dumps[-1]
+        match = TASK_PATTERN.search(line)
+        if match:
+            dump.tasks[int(match.group(1))] = match.group(2)
+            continue
+        match = DATA_PATTERN.search(line)
+        if match:
+            try:
+                dump.chunks[int(match.group(1))] = base64.b64decode(match.group(2))
+            except binascii.Error:
+                print(f"Bad trace data at offset {match.group(1)}", file=sys.stderr)
+            continue
+        if END_PATTERN.search(line):
+            dump.complete = True
+    return dumps
+
+
+class Timeline:
+    """Build Chrome trace events, and measure interrupt-to-task latency."""
+
+    def __init__(self, dump):
+        self.tasks = dump.tasks
+        self.events = dump.events()
+        self.start = self.events[0][0] if self.events else 0
+        self.output = []
+        self.latencies = []
+
+    def task_name(self, task):
+        return self.tasks.get(task, f"task {task}")
+
+    def add(self, phase, name, track, time_us, **fields):
+        self.output.append(dict(ph=phase, name=name, pid=1, tid=track, ts=time_us - self.start, **fields))
+
+    def build(self):
+        self.output.append(dict(ph="M", name="process_name", pid=1, args=dict(name="FreeRTOS")))
+        for number, name in self.tasks.items():
+            self.output.append(dict(ph="M", name="thread_name", pid=1, tid=number, args=dict(name=name)))
+        for irq, name in IRQ_NAMES.items():
+            self.output.append(dict(ph="M", name="thread_name", pid=1, tid=ISR_TRACK_BASE + irq,
+                                    args=dict(name=f"{name} IRQ")))
+
+        running = {}
+        isr_stack = []
+        pending = []
+        flow = 0
+        for index, (time_us, kind, task, arg) in enumerate(self.events):
+            if kind == TASK_IN:
+                running[task] = time_us
+                for wake in pending:
+                    if wake["task"] == task and "run_us" not in wake:
+                        wake["run_us"] = time_us
+            elif kind == TASK_OUT:
+                if task in running:
+                    begin = running.pop(task)
+                    self.add("X", self.task_name(task), task, begin, dur=time_us - begin)
+            elif kind == ISR_ENTER:
+                isr_stack.append((arg, time_us))
+            elif kind == ISR_EXIT:
+                if isr_stack and isr_stack[-1][0] == arg:
+                    _, begin = isr_stack.pop()
+                    self.add("X", f"{IRQ_NAMES.get(arg, arg)} IRQ", ISR_TRACK_BASE + arg, begin, dur=time_us - begin)
+            elif kind in (NOTIFY, NOTIFY_FROM_ISR):
+                # Only a notification which woke its target can be followed
+                target = self.readied_task(index)
+                if kind == NOTIFY_FROM_ISR and isr_stack:
+                    irq, entered = isr_stack[-1]
+                    track = ISR_TRACK_BASE + irq
+                else:
+                    irq, entered = None, None
+                    track = task if kind == NOTIFY else self.current_task(index)
+                if target is None:
+                    self.add("i", f"notify [{arg}]", track, time_us, s="t")
+                    continue
+                flow += 1
+                wake = dict(task=target, flow=flow)
+                if irq is not None:
+                    wake.update(irq=irq, entered=entered)
+                pending.append(wake)
+                self.add("i", f"notify {self.task_name(target)} [{arg}]", track, time_us, s="t")
+                self.add("s", "notify", track, time_us, id=flow, cat="notify")
+            elif kind == NOTIFY_RECEIVED:
+                self.add("i", f"notified [{arg}]", task, time_us, s="t")
+                for wake in [wake for wake in pending if wake["task"] == task]:
+                    self.add("f", "notify", task, time_us, id=wake["flow"], cat="notify", bp="e")
+                    if "irq" in wake:
+                        self.latencies.append((wake["irq"], wake["entered"], task,
+                                               wake.get("run_us", time_us), time_us))
+                    pending.remove(wake)
+            elif kind == TIMER_COMMAND:
+                self.add("i", f"timer {TIMER_COMMANDS.get(arg, arg)}", task, time_us, s="t")
+            elif kind == TIMER_EXPIRED:
+                self.add("i", "timer expired", task, time_us, s="t")
+            elif kind == TRIGGER:
+                self.add("i", "trigger", task, time_us, s="g")
+
+        # Close the slices still open when the dump was taken
+        end = self.events[-1][0] if self.events else 0
+        for task, begin in running.items():
+            self.add("X", self.task_name(task), task, begin, dur=end - begin)
+
+        return dict(traceEvents=self.output, displayTimeUnit="ns")
+
+    def readied_task(self, index):
+        """The task a notification woke: the TASK_READY event after it, past
+        any interrupts which nested in between, or None if it woke none."""
+        for _, kind, task, _ in self.events[index + 1:]:
+            if kind == TASK_READY:
+                return task
+            if kind not in (ISR_ENTER, ISR_EXIT):
+                return None
+        return None
+
+    def current_task(self, index):
+        """The task running at an event: the last one switched in before it."""
+        for time_us, kind, task, _ in reversed(self.events[:index + 1]):
+            if kind == TASK_IN:
+                return task
+        return self.events[index][2]
+
+    def report(self, file):
+        if not self.latencies:
+            print("No notifications from interrupts were received in this dump", file=file)
+            return
+
+        print(f"{'IRQ':<10}{'Task':<16}{'Start':>12}{'Run':>10}{'Receive':>10}  (us)", file=file)
+        for irq, entered, task, run_us, received in self.latencies:
+            print(f"{IRQ_NAMES.get(irq, irq):<10}{self.task_name(task):<16}{entered - self.start:>12.1f}"
+                  f"{run_us - entered:>10.1f}{received - entered:>10.1f}", file=file)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a kernel trace dump to Chrome trace JSON")
+    parser.add_argument("log", nargs="?", help="device log output holding 'Trace ...' lines (default: stdin)")
+    parser.add_argument("-o", "--output", help="where to write the JSON (default: stdout)")
+    parser.add_argument("--cycles-per-us", type=int, default=160,
+                        help="the cycle counter's rate, for dumps which don't give it (default: 160)")
+    parser.add_argument("--dump", type=int, default=-1, help="which dump to convert, from 0 (default: the last)")
+    args = parser.parse_args()
+
+    if args.log:
+        with open(args.log, errors="replace") as file:
+            dumps = read_dumps(file, args.cycles_per_us)
+    else:
+        dumps = read_dumps(sys.stdin, args.cycles_per_us)
+
+    if not dumps:
+        sys.exit("No trace dumps found")
+    try:
+        dump = dumps[args.dump]
+    except IndexError:
+        sys.exit(f"There are only {len(dumps)} dumps")
+    if not dump.complete:
+        print("The dump is incomplete: some lines may have been lost", file=sys.stderr)
+
+    timeline = Timeline(dump)
+    trace = timeline.build()
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(trace, file)
+    else:
+        json.dump(trace, sys.stdout)
+        print()
+
+    timeline.report(sys.stderr)
+
+
+if __name__ == "__main__":
+    main()